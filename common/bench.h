@@ -0,0 +1,115 @@
+/* bench.h
+
+   Small helpers shared by the benchmark programs: a monotonic clock in
+   nanoseconds, CPU pinning, and percentile summaries of latency samples.
+
+   Latencies are collected as raw per-call samples (uint64_t nanoseconds),
+   sorted once, and then summarised; the cost of reading the clock itself
+   is measured with bench_clock_overhead_ns() so callers can subtract it.
+
+   bench_metric() additionally emits a result as a "BENCH <name> <value>"
+   line when BENCH_METRICS is set in the environment, which is how
+   bench_compare collects results for its baseline and regression checks.
+
+   Include this after defining _GNU_SOURCE (needed for the CPU_* macros).
+*/
+
+#ifndef COMMON_BENCH_H
+#define COMMON_BENCH_H
+
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Pin the calling thread to one CPU. Returns 0 on success, -1 on error. */
+static inline int bench_pin_cpu(int cpu)
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/* Smallest observed cost of back-to-back bench_now_ns() calls. */
+static inline uint64_t bench_clock_overhead_ns(void)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t t0 = bench_now_ns();
+        uint64_t t1 = bench_now_ns();
+        if (t1 - t0 < best)
+            best = t1 - t0;
+    }
+    return best;
+}
+
+static inline int bench_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void bench_sort(uint64_t *samples, size_t n)
+{
+    qsort(samples, n, sizeof(*samples), bench_cmp_u64);
+}
+
+/* p in [0, 1]; samples must already be sorted. */
+static inline uint64_t bench_percentile(const uint64_t *sorted, size_t n, double p)
+{
+    if (n == 0)
+        return 0;
+    size_t idx = (size_t)(p * (double)(n - 1) + 0.5);
+    return sorted[idx < n ? idx : n - 1];
+}
+
+struct bench_summary {
+    uint64_t min, p50, p99, p999, max;
+    double mean;
+};
+
+/* Sorts the samples in place and fills in the summary. */
+static inline void bench_summarize(uint64_t *samples, size_t n, struct bench_summary *s)
+{
+    double sum = 0;
+    bench_sort(samples, n);
+    for (size_t i = 0; i < n; i++)
+        sum += (double)samples[i];
+    s->min = n ? samples[0] : 0;
+    s->max = n ? samples[n - 1] : 0;
+    s->p50 = bench_percentile(samples, n, 0.50);
+    s->p99 = bench_percentile(samples, n, 0.99);
+    s->p999 = bench_percentile(samples, n, 0.999);
+    s->mean = n ? sum / (double)n : 0;
+}
+
+/* Emit one machine-readable result, named by fmt (dotted, e.g.
+   "ancestor_pid.syscall.n3.p50_ns"), if BENCH_METRICS is set. Values are
+   costs: bench_compare treats an increase as a regression. */
+static inline void bench_metric(double value, const char *fmt, ...)
+{
+    static int enabled = -1;
+    if (enabled == -1)
+        enabled = getenv("BENCH_METRICS") != NULL;
+    if (!enabled)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    printf("BENCH ");
+    vprintf(fmt, ap);
+    printf(" %.3f\n", value);
+    va_end(ap);
+}
+
+#endif /* COMMON_BENCH_H */
@@ -0,0 +1,365 @@
+/* bench_compare.c
+
+   Baseline store and regression check for the benchmarks.
+
+   Runs a benchmark command `repeats` times with BENCH_METRICS=1 in its
+   environment and collects the "BENCH <name> <value>" lines it prints
+   (bench_metric() in bench.h): one sample per metric per run. Then:
+
+     record   stores the samples in the baseline file, replacing earlier
+              samples of the same metrics and keeping all others, so one
+              file can hold the baseline of every benchmark;
+     compare  tests every metric of the run against its baseline samples,
+              and lists the baseline metrics of the same benchmark (the
+              same name up to the first '.') that the run did not print.
+
+   Metrics are costs (lower is better). A metric has regressed when its
+   median grew by more than the threshold and a one-sided Mann-Whitney U
+   test says the new samples are larger with p < alpha; improvements are
+   reported the same way the other way round. The test only looks at
+   ranks, so the odd run disturbed by a background task does not decide
+   the outcome the way it would move a mean. It uses the normal
+   approximation with tie and continuity corrections; note that with few
+   repetitions small p are out of reach (5 vs 5 runs can at best give
+   p = 1/252 exactly), hence the default of 10.
+
+   Exit status: 0 if nothing regressed, 1 if something did, 2 if the
+   benchmark or the baseline could not be used, including when the run
+   lacks metrics of its benchmark that the baseline has.
+
+   Compile with:
+       gcc -O2 -Wall -o bench_compare bench_compare.c -lm
+
+   Usage:
+       ./bench_compare [-n repeats] [-t threshold_pct] [-a alpha] [-f baseline] [-v]
+                       record|compare command [args ...]
+
+   For example:
+       ./bench_compare -f kernel.base record ../task1/ancestor_pid_bench -i 100000
+       ./bench_compare -f kernel.base compare ../task1/ancestor_pid_bench -i 100000
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <sys/wait.h>
+
+static int repeats = 10;
+static double threshold_pct = 5.0;
+static double alpha = 0.01;
+static const char *baseline_path = "bench.baseline";
+static int verbose = 0;
+
+struct metric {
+    char *name;
+    double *v;
+    int n, cap;
+};
+
+struct metric_set {
+    struct metric *m;
+    int n, cap;
+};
+
+static struct metric *metric_find(struct metric_set *set, const char *name, int create) {
+    for (int i = 0; i < set->n; i++)
+        if (strcmp(set->m[i].name, name) == 0)
+            return &set->m[i];
+    if (!create)
+        return NULL;
+    if (set->n == set->cap) {
+        set->cap = set->cap ? 2 * set->cap : 64;
+        set->m = realloc(set->m, set->cap * sizeof(*set->m));
+        if (!set->m) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    struct metric *m = &set->m[set->n++];
+    memset(m, 0, sizeof(*m));
+    m->name = strdup(name);
+    return m;
+}
+
+static void metric_add(struct metric *m, double v) {
+    if (m->n == m->cap) {
+        m->cap = m->cap ? 2 * m->cap : 16;
+        m->v = realloc(m->v, m->cap * sizeof(*m->v));
+        if (!m->v) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    m->v[m->n++] = v;
+}
+
+/* Run the benchmark once and add its metrics to set. Returns 0 or -1. */
+static int run_once(char **cmd, struct metric_set *set) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        return -1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        setenv("BENCH_METRICS", "1", 1);
+        execvp(cmd[0], cmd);
+        perror(cmd[0]);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    FILE *in = fdopen(fds[0], "r");
+    char line[512], name[256];
+    double value;
+    int found = 0;
+    while (fgets(line, sizeof(line), in)) {
+        if (sscanf(line, "BENCH %255s %lf", name, &value) == 2) {
+            metric_add(metric_find(set, name, 1), value);
+            found++;
+        } else if (verbose) {
+            fputs(line, stdout);
+        }
+    }
+    fclose(in);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed (status %d)\n", cmd[0],
+                WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+        return -1;
+    }
+    if (!found) {
+        fprintf(stderr, "%s printed no BENCH lines\n", cmd[0]);
+        return -1;
+    }
+    return 0;
+}
+
+/* Baseline file: one metric per line, "<name> <sample> <sample> ...". */
+static int load_baseline(struct metric_set *set) {
+    FILE *f = fopen(baseline_path, "r");
+    if (!f)
+        return -1;
+    char *line = NULL;
+    size_t size = 0;
+    while (getline(&line, &size, f) != -1) {
+        char *save, *tok = strtok_r(line, " \t\n", &save);
+        if (!tok || tok[0] == '#')
+            continue;
+        struct metric *m = metric_find(set, tok, 1);
+        while ((tok = strtok_r(NULL, " \t\n", &save)))
+            metric_add(m, strtod(tok, NULL));
+    }
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+static int save_baseline(const struct metric_set *set) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", baseline_path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        perror(tmp);
+        return -1;
+    }
+    fprintf(f, "# bench_compare baseline: <metric> <sample> ...\n");
+    for (int i = 0; i < set->n; i++) {
+        fprintf(f, "%s", set->m[i].name);
+        for (int j = 0; j < set->m[i].n; j++)
+            fprintf(f, " %.3f", set->m[i].v[j]);
+        fprintf(f, "\n");
+    }
+    if (fclose(f) != 0 || rename(tmp, baseline_path) == -1) {
+        perror(baseline_path);
+        return -1;
+    }
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(const double *v, int n) {
+    double *s = malloc(n * sizeof(*s));
+    memcpy(s, v, n * sizeof(*s));
+    qsort(s, n, sizeof(*s), cmp_double);
+    double m = n % 2 ? s[n / 2] : (s[n / 2 - 1] + s[n / 2]) / 2;
+    free(s);
+    return m;
+}
+
+struct ranked {
+    double v;
+    int in_b;
+};
+
+static int cmp_ranked(const void *a, const void *b) {
+    return cmp_double(&((const struct ranked *)a)->v, &((const struct ranked *)b)->v);
+}
+
+/* One-sided Mann-Whitney U test: p-value for "samples b tend to be larger
+   than samples a", by the normal approximation with tie and continuity
+   corrections. */
+static double mann_whitney_p(const double *a, int na, const double *b, int nb) {
+    int n = na + nb;
+    struct ranked *r = malloc(n * sizeof(*r));
+    for (int i = 0; i < na; i++)
+        r[i] = (struct ranked){ a[i], 0 };
+    for (int i = 0; i < nb; i++)
+        r[na + i] = (struct ranked){ b[i], 1 };
+    qsort(r, n, sizeof(*r), cmp_ranked);
+
+    /* Tied values share the average of their ranks. */
+    double rank_sum_b = 0, ties = 0;
+    for (int i = 0; i < n;) {
+        int j = i;
+        while (j < n && r[j].v == r[i].v)
+            j++;
+        double rank = (i + 1 + j) / 2.0, t = j - i;
+        for (int k = i; k < j; k++)
+            if (r[k].in_b)
+                rank_sum_b += rank;
+        ties += t * t * t - t;
+        i = j;
+    }
+    free(r);
+
+    double u = rank_sum_b - nb * (nb + 1) / 2.0;
+    double mu = na * (double)nb / 2;
+    double var = na * (double)nb / 12 * ((n + 1) - ties / ((double)n * (n - 1)));
+    if (var <= 0)
+        return 1.0;
+    double z = (u - mu - 0.5) / sqrt(var);
+    return 0.5 * erfc(z / M_SQRT2);
+}
+
+/* Whether metrics a and b belong to the same benchmark: the same name up
+   to the first '.'. */
+static int same_benchmark(const char *a, const char *b) {
+    size_t len = strcspn(a, ".");
+    return strncmp(a, b, len) == 0 && b[len] == a[len];
+}
+
+/* Compare the run with the baseline and print a table. Returns the exit
+   status (see above). */
+static int compare(const struct metric_set *base, const struct metric_set *run) {
+    int regressions = 0, missing = 0;
+    printf("%-44s %12s %12s %8s %8s  %s\n", "metric", "base p50", "new p50", "change", "p",
+           "verdict");
+    for (int i = 0; i < run->n; i++) {
+        const struct metric *m = &run->m[i];
+        struct metric *b = metric_find((struct metric_set *)base, m->name, 0);
+        double now = median(m->v, m->n);
+        if (!b || b->n == 0) {
+            printf("%-44s %12s %12.1f %8s %8s  no baseline\n", m->name, "-", now, "-", "-");
+            continue;
+        }
+        double was = median(b->v, b->n);
+        double change = was > 0 ? 100.0 * (now - was) / was : 0.0;
+        double p_worse = mann_whitney_p(b->v, b->n, m->v, m->n);
+        double p_better = mann_whitney_p(m->v, m->n, b->v, b->n);
+        const char *verdict = "ok";
+        double p = p_worse;
+        if (change > threshold_pct && p_worse < alpha) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (change < -threshold_pct && p_better < alpha) {
+            verdict = "improved";
+            p = p_better;
+        }
+        printf("%-44s %12.1f %12.1f %+7.1f%% %8.4f  %s\n", m->name, was, now, change, p, verdict);
+    }
+    for (int i = 0; i < base->n; i++) {
+        const struct metric *b = &base->m[i];
+        if (metric_find((struct metric_set *)run, b->name, 0))
+            continue;
+        for (int j = 0; j < run->n; j++) {
+            if (same_benchmark(b->name, run->m[j].name)) {
+                printf("%-44s %12.1f %12s %8s %8s  MISSING\n", b->name,
+                       b->n ? median(b->v, b->n) : 0.0, "-", "-", "-");
+                missing++;
+                break;
+            }
+        }
+    }
+    printf("\n%d of %d metric(s) regressed by more than %.1f%% (alpha %.3g, %d run(s))\n",
+           regressions, run->n, threshold_pct, alpha, repeats);
+    if (missing) {
+        printf("%d baseline metric(s) missing from the run\n", missing);
+        return 2;
+    }
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    /* '+': stop at the mode so the benchmark keeps its own options. */
+    while ((opt = getopt(argc, argv, "+n:t:a:f:v")) != -1) {
+        switch (opt) {
+        case 'n': repeats = atoi(optarg); break;
+        case 't': threshold_pct = atof(optarg); break;
+        case 'a': alpha = atof(optarg); break;
+        case 'f': baseline_path = optarg; break;
+        case 'v': verbose = 1; break;
+        default:
+            goto usage;
+        }
+    }
+    if (argc - optind < 2)
+        goto usage;
+    const char *mode = argv[optind];
+    char **cmd = argv + optind + 1;
+    if ((strcmp(mode, "record") != 0 && strcmp(mode, "compare") != 0) || repeats < 1 ||
+        threshold_pct < 0 || alpha <= 0 || alpha >= 1)
+        goto usage;
+
+    struct metric_set run = { 0 }, base = { 0 };
+    for (int r = 0; r < repeats; r++) {
+        if (run_once(cmd, &run) == -1)
+            return 2;
+        fprintf(stderr, "\rrun %d/%d", r + 1, repeats);
+    }
+    fprintf(stderr, "\n");
+
+    if (strcmp(mode, "record") == 0) {
+        load_baseline(&base);
+        for (int i = 0; i < run.n; i++) {
+            struct metric *m = metric_find(&base, run.m[i].name, 1);
+            m->n = 0;
+            for (int j = 0; j < run.m[i].n; j++)
+                metric_add(m, run.m[i].v[j]);
+        }
+        if (save_baseline(&base) == -1)
+            return 2;
+        printf("Recorded %d metric(s) x %d run(s) in %s\n", run.n, repeats, baseline_path);
+        return 0;
+    }
+
+    if (load_baseline(&base) == -1) {
+        perror(baseline_path);
+        return 2;
+    }
+    return compare(&base, &run);
+
+usage:
+    fprintf(stderr, "Usage: %s [-n repeats] [-t threshold_pct] [-a alpha] [-f baseline] [-v]\n"
+                    "       %*s record|compare command [args ...]\n",
+            argv[0], (int)strlen(argv[0]), "");
+    return 2;
+}
@@ -0,0 +1,132 @@
+/* latch.h
+
+   A cross-process start latch that lives in a MAP_SHARED page.
+
+   The tests fork a tree of descendants, wait for every one of them to be
+   in place, perform the action under test, and then let the descendants
+   observe the result. Sleeping for a fixed time to "let the children get
+   ready" is both slow and racy on a loaded machine, so instead:
+
+     - every descendant calls latch_arrive() once it is set up and then
+       blocks in latch_wait_go();
+     - the parent blocks in latch_wait_ready(latch, n) until n descendants
+       have arrived, performs the action, and calls latch_release().
+
+   Both counters are plain ints in shared memory; waiting is done with
+   (non-private) futexes so processes only sleep in the kernel when they
+   actually have to wait.
+
+   The latch must be created before the fork()s so that every process
+   shares the same mapping.
+*/
+
+#ifndef COMMON_LATCH_H
+#define COMMON_LATCH_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* How long latch_wait_ready() waits before giving up, so that a descendant
+   that died before arriving fails the test instead of hanging it. */
+#define LATCH_TIMEOUT_SEC 10
+
+struct latch {
+    atomic_int ready;   /* number of processes that have arrived */
+    atomic_int go;      /* 0 until latch_release() is called */
+};
+
+static inline long latch_futex(atomic_int *addr, int op, int val,
+                               const struct timespec *timeout)
+{
+    return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+/* Map a new, zeroed latch shared with all future children.
+   Returns NULL (with errno set) on failure. */
+static inline struct latch *latch_create(void)
+{
+    struct latch *l = mmap(NULL, sizeof(*l), PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (l == MAP_FAILED)
+        return NULL;
+    atomic_init(&l->ready, 0);
+    atomic_init(&l->go, 0);
+    return l;
+}
+
+static inline void latch_destroy(struct latch *l)
+{
+    if (l)
+        munmap(l, sizeof(*l));
+}
+
+/* Re-arm a latch for the next test. Only valid once every process that used
+   it in the previous round has finished with it. */
+static inline void latch_reset(struct latch *l)
+{
+    atomic_store(&l->ready, 0);
+    atomic_store(&l->go, 0);
+}
+
+/* Called by a descendant once it is ready for the action under test. */
+static inline void latch_arrive(struct latch *l)
+{
+    atomic_fetch_add_explicit(&l->ready, 1, memory_order_release);
+    latch_futex(&l->ready, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/* Block until at least n processes have arrived.
+   Returns 0 on success, or -1 with errno == ETIMEDOUT after
+   LATCH_TIMEOUT_SEC seconds. */
+static inline int latch_wait_ready(struct latch *l, int n)
+{
+    struct timespec now, deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += LATCH_TIMEOUT_SEC;
+
+    for (;;) {
+        int seen = atomic_load_explicit(&l->ready, memory_order_acquire);
+        if (seen >= n)
+            return 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        struct timespec left = {
+            .tv_sec = deadline.tv_sec - now.tv_sec,
+            .tv_nsec = deadline.tv_nsec - now.tv_nsec,
+        };
+        if (left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000L;
+        }
+        if (left.tv_sec < 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        /* EAGAIN means the counter moved under us; just re-check it. */
+        latch_futex(&l->ready, FUTEX_WAIT, seen, &left);
+    }
+}
+
+/* Let every process blocked in latch_wait_go() continue. */
+static inline void latch_release(struct latch *l)
+{
+    atomic_store_explicit(&l->go, 1, memory_order_release);
+    latch_futex(&l->go, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/* Called by a descendant after latch_arrive(); returns once the parent has
+   called latch_release(). */
+static inline void latch_wait_go(struct latch *l)
+{
+    while (atomic_load_explicit(&l->go, memory_order_acquire) == 0)
+        latch_futex(&l->go, FUTEX_WAIT, 0, NULL);
+}
+
+#endif /* COMMON_LATCH_H */
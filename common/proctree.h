@@ -0,0 +1,684 @@
+/* proctree.h
+
+   Declarative process-tree builder for the task suites.
+
+   A tree is described by a spec string such as
+
+       P1(P2(P3,P4*),P5)
+
+   where every name is a node, a parenthesised list gives its children, and
+   a trailing '*' marks a node that exits before the action under test and
+   is left as a zombie (its parent collects it with WNOWAIT). Children of
+   such a node are orphaned and reparented as usual. Names are made of
+   letters, digits and '_'; the root is the calling process itself and
+   cannot be marked dead.
+
+       struct proctree t;
+       proctree_create(&t, "P1(P2(P3,P4*),P5)");
+       proctree_spawn(&t, setup, run, arg);   returns with every live node parked
+       ... action under test ...
+       proctree_release(&t);                  live nodes call run() and report
+       proctree_finish(&t);                   waits, kills stragglers, reaps
+       pid_t p3 = t.nodes[proctree_find(&t, "P3")].pid;
+       const struct result_slot *r = results_get(t.results, proctree_find(&t, "P3"));
+       proctree_destroy(&t);
+
+   In every non-root node, setup(t, idx, arg) runs first (so a nice value
+   or affinity it sets is inherited by the node's own children), then the
+   node forks its children, records its PID in the shared node table, and
+   either exits (dead nodes) or parks on the tree's latch. After
+   proctree_release() each live node calls run(t, idx, arg) and reports its
+   return value in slot idx of the tree's results table (../common/results.h);
+   either callback may be NULL. Every node forks its own children, so
+   subtrees are built in parallel.
+
+   proctree_finish() waits for every live node to report, SIGKILLs those
+   that have not reported once no new report arrived for
+   RESULTS_TIMEOUT_SEC, and reaps the caller's direct children; every node
+   reaps its own. Orphans are reaped by whoever adopted them.
+
+   Spawn modes. By default (PROCTREE_FORK) every node is a fork() of its
+   parent, which copies the parent's page tables: cheap for a small test
+   process, but it dominates the setup time of large trees built by a
+   process with a big address space. Setting t.mode = PROCTREE_CLONE_VM
+   before proctree_spawn() creates each node with clone(CLONE_VM) on a
+   small stack of its own instead, so nothing is copied. Such nodes share
+   the caller's memory -- globals, errno, stdio buffers and locks -- so in
+   this mode the callbacks must stick to plain system calls, must not write
+   to memory another node uses, and the caller must save errno before
+   proctree_release(). The kernel clears each node's `clear_tid` when it
+   exits (CLONE_CHILD_CLEARTID), which is how proctree_finish() knows a
+   stack is no longer in use, even for orphans.
+
+   A pool (proctree_pool_create()) is a set of idle CLONE_VM stubs forked
+   ahead of time as children of the caller. When t.pool is set, the live
+   children of the root are taken from the pool instead of being created,
+   and go back to it once proctree_finish() is done with them; everything
+   below them is still created on the spot, as a process can only ever be
+   the child of the process that created it. A stub starts every job at the
+   caller's current nice value, but keeps any other state (affinity, ...)
+   a previous setup() left behind. A stub whose nice value cannot be reset
+   (a job raised it, and lowering it needs CAP_SYS_NICE) is retired rather
+   than reused, and its node is created on the spot instead.
+*/
+
+#ifndef COMMON_PROCTREE_H
+#define COMMON_PROCTREE_H
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "latch.h"
+#include "results.h"
+
+#define PROCTREE_NAME_MAX 16
+#define PROCTREE_MAX_LEVELS 16             /* of a shape, see proctree_parse_shape() */
+#define PROCTREE_MAX_SHAPE_NODES 4194304L  /* PID_MAX_LIMIT: more cannot exist at once */
+#define PROCTREE_STACK_SIZE (64 * 1024)    /* per CLONE_VM node */
+
+enum proctree_mode {
+    PROCTREE_FORK,          /* fork(): every node has its own copy of memory */
+    PROCTREE_CLONE_VM,      /* clone(CLONE_VM): nodes share the caller's memory */
+};
+
+struct proctree_node {
+    char name[PROCTREE_NAME_MAX];
+    pid_t pid;              /* filled in once the node has been forked */
+    int parent;             /* index of the parent node, -1 for the root */
+    int depth;              /* 0 for the root */
+    int dead;               /* exits before the action ('*') */
+    int first_child;        /* index, or -1 */
+    int next_sibling;       /* index, or -1 */
+    int stub;               /* pool stub serving the node, or -1 */
+    pid_t clear_tid;        /* CLONE_VM: nonzero until the node has exited */
+};
+
+struct proctree;
+
+enum { PROCTREE_STUB_IDLE, PROCTREE_STUB_BUSY, PROCTREE_STUB_EXIT, PROCTREE_STUB_LOST };
+
+struct proctree_stub {
+    atomic_int state;       /* PROCTREE_STUB_* */
+    pid_t pid;
+    pid_t clear_tid;
+    struct proctree *tree;  /* job: serve node idx of tree */
+    int idx;
+};
+
+struct proctree_pool {
+    int size;
+    struct proctree_stub *stubs;
+    char *stacks;
+    size_t stacks_size;
+};
+
+typedef int (*proctree_fn)(struct proctree *t, int idx, void *arg);
+
+struct proctree {
+    int n;                          /* nodes, in spec (pre-)order */
+    int live;                       /* live nodes other than the root */
+    struct proctree_node *nodes;    /* shared with the whole tree */
+    size_t nodes_size;
+    struct latch *latch;
+    struct results *results;
+    proctree_fn setup, run;
+    void *arg;
+    int mode;                       /* enum proctree_mode, PROCTREE_FORK by default */
+    struct proctree_pool *pool;     /* optional, CLONE_VM mode only */
+    int nice;                       /* caller's nice value at spawn time */
+    char *stacks;                   /* CLONE_VM: one stack per node */
+};
+
+static inline int proctree_run_node(struct proctree *t, int idx);
+
+static inline int proctree_name_char(char c)
+{
+    return c == '_' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Number of nodes in spec, or -1 if it is malformed. */
+static inline int proctree_count(const char *spec)
+{
+    enum { NAME_NEXT, IN_NAME, AFTER_STAR, AFTER_CLOSE } state = NAME_NEXT;
+    int n = 0, open = 0;
+    for (const char *p = spec; *p; p++) {
+        if (proctree_name_char(*p)) {
+            if (state == NAME_NEXT)
+                n++;
+            else if (state != IN_NAME)
+                return -1;
+            state = IN_NAME;
+        } else if (*p == '*') {
+            if (state != IN_NAME)
+                return -1;
+            state = AFTER_STAR;
+        } else if (*p == '(') {
+            if (state != IN_NAME && state != AFTER_STAR)
+                return -1;
+            open++;
+            state = NAME_NEXT;
+        } else if (*p == ',' || *p == ')') {
+            if (state == NAME_NEXT || open == 0)
+                return -1;
+            if (*p == ')')
+                open--;
+            state = *p == ')' ? AFTER_CLOSE : NAME_NEXT;
+        } else {
+            return -1;
+        }
+    }
+    return state == NAME_NEXT || open ? -1 : n;
+}
+
+/* Recursive-descent parser for one node and its children; the spec has
+   already been validated by proctree_count(). */
+static inline const char *proctree_parse_node(struct proctree *t, const char *p, int parent)
+{
+    int idx = t->n++;
+    struct proctree_node *node = &t->nodes[idx];
+    size_t len = 0;
+
+    while (proctree_name_char(*p)) {
+        if (len < PROCTREE_NAME_MAX - 1)
+            node->name[len++] = *p;
+        p++;
+    }
+    node->name[len] = '\0';
+    node->parent = parent;
+    node->depth = parent < 0 ? 0 : t->nodes[parent].depth + 1;
+    node->first_child = node->next_sibling = -1;
+    if (*p == '*') {
+        node->dead = 1;
+        p++;
+    }
+    if (*p == '(') {
+        int last = -1;
+        do {
+            int child = t->n;
+            p = proctree_parse_node(t, p + 1, idx);
+            if (last < 0)
+                node->first_child = child;
+            else
+                t->nodes[last].next_sibling = child;
+            last = child;
+        } while (*p == ',');
+        p++;    /* ')' */
+    }
+    return p;
+}
+
+static inline void proctree_destroy(struct proctree *t)
+{
+    if (t->stacks)
+        munmap(t->stacks, (size_t)t->n * PROCTREE_STACK_SIZE);
+    if (t->nodes)
+        munmap(t->nodes, t->nodes_size);
+    latch_destroy(t->latch);
+    results_destroy(t->results);
+    memset(t, 0, sizeof(*t));
+}
+
+/* Parse spec and map the shared state for a tree.
+   Returns 0, or -1 with errno == EINVAL for a malformed spec or a dead root,
+   or ENOMEM. */
+static inline int proctree_create(struct proctree *t, const char *spec)
+{
+    memset(t, 0, sizeof(*t));
+    int n = proctree_count(spec);
+    if (n <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    t->nodes_size = (size_t)n * sizeof(struct proctree_node);
+    t->nodes = mmap(NULL, t->nodes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (t->nodes == MAP_FAILED) {
+        t->nodes = NULL;
+        return -1;
+    }
+    t->latch = latch_create();
+    t->results = results_create(n);
+    if (!t->latch || !t->results) {
+        proctree_destroy(t);
+        errno = ENOMEM;
+        return -1;
+    }
+    proctree_parse_node(t, spec, -1);
+    if (t->nodes[0].dead) {
+        proctree_destroy(t);
+        errno = EINVAL;
+        return -1;
+    }
+    for (int i = 1; i < n; i++)
+        t->live += !t->nodes[i].dead;
+    return 0;
+}
+
+/* Index of the node called name, or -1. */
+static inline int proctree_find(const struct proctree *t, const char *name)
+{
+    for (int i = 0; i < t->n; i++)
+        if (strcmp(t->nodes[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+/* PID of the node called name, or -1. */
+static inline pid_t proctree_pid(const struct proctree *t, const char *name)
+{
+    int idx = proctree_find(t, name);
+    return idx < 0 ? -1 : t->nodes[idx].pid;
+}
+
+static inline long proctree_futex(void *addr, int op, int val, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+/* Where the clone() arguments of node idx live: at the top of its stack. */
+struct proctree_clone_arg {
+    struct proctree *tree;
+    int idx;
+};
+
+static inline int proctree_clone_main(void *arg)
+{
+    struct proctree_clone_arg *a = arg;
+    return proctree_run_node(a->tree, a->idx);
+}
+
+/* Hand node idx to an idle stub of the pool, reset to the caller's nice
+   value as a fresh child would have. A stub that cannot be reset is told
+   to exit. Returns its PID, or 0 if no stub is idle. */
+static inline pid_t proctree_pool_take(struct proctree *t, int idx)
+{
+    struct proctree_pool *pool = t->pool;
+    for (int i = 0; i < pool->size; i++) {
+        struct proctree_stub *s = &pool->stubs[i];
+        if (atomic_load(&s->state) != PROCTREE_STUB_IDLE)
+            continue;
+        if (setpriority(PRIO_PROCESS, s->pid, t->nice) == -1) {
+            atomic_store(&s->state, PROCTREE_STUB_EXIT);
+            proctree_futex(&s->state, FUTEX_WAKE, 1, NULL);
+            continue;
+        }
+        s->tree = t;
+        s->idx = idx;
+        t->nodes[idx].stub = i;
+        atomic_store(&s->state, PROCTREE_STUB_BUSY);
+        proctree_futex(&s->state, FUTEX_WAKE, 1, NULL);
+        return s->pid;
+    }
+    return 0;
+}
+
+/* Create the process of node c, a child of the caller. Returns its PID,
+   or -1 with errno set. */
+static inline pid_t proctree_new_node(struct proctree *t, int c)
+{
+    struct proctree_node *node = &t->nodes[c];
+    if (t->mode == PROCTREE_FORK) {
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(proctree_run_node(t, c));
+        return pid;
+    }
+
+    if (t->pool && node->parent == 0 && !node->dead) {
+        pid_t pid = proctree_pool_take(t, c);
+        if (pid > 0)
+            return pid;
+    }
+    char *top = t->stacks + (size_t)(c + 1) * PROCTREE_STACK_SIZE;
+    struct proctree_clone_arg *arg = (struct proctree_clone_arg *)top - 1;
+    arg->tree = t;
+    arg->idx = c;
+    __atomic_store_n(&node->clear_tid, 1, __ATOMIC_RELAXED);
+    pid_t pid = clone(proctree_clone_main, arg, CLONE_VM | CLONE_CHILD_CLEARTID | SIGCHLD,
+                      arg, NULL, NULL, &node->clear_tid);
+    if (pid < 0)
+        __atomic_store_n(&node->clear_tid, 0, __ATOMIC_RELAXED);
+    return pid;
+}
+
+/* Create the children of node idx; dead ones are left as zombies. */
+static inline void proctree_fork_children(struct proctree *t, int idx)
+{
+    for (int c = t->nodes[idx].first_child; c >= 0; c = t->nodes[c].next_sibling) {
+        pid_t pid = proctree_new_node(t, c);
+        if (pid < 0) {
+            if (t->mode == PROCTREE_FORK)
+                perror("fork");
+            continue;
+        }
+        t->nodes[c].pid = pid;
+    }
+    for (int c = t->nodes[idx].first_child; c >= 0; c = t->nodes[c].next_sibling) {
+        siginfo_t info;
+        if (t->nodes[c].dead && t->nodes[c].pid > 0)
+            waitid(P_PID, t->nodes[c].pid, &info, WEXITED | WNOWAIT);
+    }
+}
+
+/* Body of every non-root node. */
+static inline int proctree_run_node(struct proctree *t, int idx)
+{
+    t->nodes[idx].pid = getpid();
+    if (t->setup)
+        t->setup(t, idx, t->arg);
+    proctree_fork_children(t, idx);
+    if (t->nodes[idx].dead) {
+        if (t->mode == PROCTREE_FORK)
+            fflush(stdout);
+        return 0;
+    }
+
+    latch_arrive(t->latch);
+    latch_wait_go(t->latch);
+    int value = t->run ? t->run(t, idx, t->arg) : 0;
+    if (t->mode == PROCTREE_FORK)
+        fflush(stdout);
+    results_report(t->results, idx, getpid(), value, 0);
+    while (wait(NULL) > 0)
+        ;
+    return 0;
+}
+
+static inline int proctree_finish(struct proctree *t);
+
+/* Build the tree below the calling process (node 0) and wait until every
+   live node is parked. Returns 0, or -1 if the stacks of a CLONE_VM tree
+   cannot be mapped or if no further node came up for LATCH_TIMEOUT_SEC
+   (the tree is then already torn down). */
+static inline int proctree_spawn(struct proctree *t, proctree_fn setup, proctree_fn run,
+                                 void *arg)
+{
+    t->setup = setup;
+    t->run = run;
+    t->arg = arg;
+    t->nice = getpriority(PRIO_PROCESS, 0);
+    if (t->mode == PROCTREE_CLONE_VM && !t->stacks) {
+        t->stacks = mmap(NULL, (size_t)t->n * PROCTREE_STACK_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (t->stacks == MAP_FAILED) {
+            t->stacks = NULL;
+            return -1;
+        }
+    }
+    latch_reset(t->latch);
+    results_reset(t->results);
+    for (int i = 0; i < t->n; i++) {
+        t->nodes[i].pid = 0;
+        t->nodes[i].stub = -1;
+    }
+    t->nodes[0].pid = getpid();
+
+    fflush(stdout);
+    proctree_fork_children(t, 0);
+    /* Big trees may take longer than LATCH_TIMEOUT_SEC to build: only give
+       up once arrivals stop. */
+    int last = -1;
+    while (latch_wait_ready(t->latch, t->live) == -1) {
+        int seen = atomic_load(&t->latch->ready);
+        if (seen == last) {
+            fprintf(stderr, "proctree: only %d of %d live nodes came up\n", seen, t->live);
+            latch_release(t->latch);
+            proctree_finish(t);
+            return -1;
+        }
+        last = seen;
+    }
+    return 0;
+}
+
+/* Let every live node run its callback. */
+static inline void proctree_release(struct proctree *t)
+{
+    latch_release(t->latch);
+}
+
+/* Wait until *addr reads `done` (with a futex on it), at most until
+   deadline. Returns 0 or -1. */
+static inline int proctree_wait_word(int *addr, int done, const struct timespec *deadline)
+{
+    int v;
+    while ((v = __atomic_load_n(addr, __ATOMIC_ACQUIRE)) != done) {
+        struct timespec now, left;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = deadline->tv_sec - now.tv_sec;
+        left.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+        if (left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000L;
+        }
+        if (left.tv_sec < 0)
+            return -1;
+        proctree_futex(addr, FUTEX_WAIT, v, &left);
+    }
+    return 0;
+}
+
+/* Wait for every live node to report, SIGKILL the ones that did not (once
+   no report has come in for RESULTS_TIMEOUT_SEC), and
+   reap the caller's children (pool stubs go back to the pool instead).
+   In CLONE_VM mode, also wait until every node has exited, so that the
+   stacks can be reused. Returns the number of nodes killed. */
+static inline int proctree_finish(struct proctree *t)
+{
+    int killed = 0, last = -1;
+    while (results_wait(t->results, t->live) == -1) {
+        int seen = atomic_load(&t->results->reported);
+        if (seen != last) {
+            last = seen;
+            continue;
+        }
+        for (int i = 1; i < t->n; i++) {
+            if (t->nodes[i].dead || t->nodes[i].pid <= 0 || results_get(t->results, i))
+                continue;
+            fprintf(stderr, "proctree: node %s (PID %d) did not finish, killing it\n",
+                    t->nodes[i].name, t->nodes[i].pid);
+            kill(t->nodes[i].pid, SIGKILL);
+            if (t->nodes[i].stub >= 0)
+                atomic_store(&t->pool->stubs[t->nodes[i].stub].state, PROCTREE_STUB_LOST);
+            killed++;
+        }
+        break;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += RESULTS_TIMEOUT_SEC;
+    for (int c = t->nodes[0].first_child; c >= 0; c = t->nodes[c].next_sibling) {
+        struct proctree_node *node = &t->nodes[c];
+        if (node->stub >= 0) {
+            /* A stub that has gone idle has reaped its subtree. */
+            struct proctree_stub *s = &t->pool->stubs[node->stub];
+            if (atomic_load(&s->state) == PROCTREE_STUB_BUSY &&
+                proctree_wait_word((int *)&s->state, PROCTREE_STUB_IDLE, &deadline) == -1)
+                fprintf(stderr, "proctree: pool stub %d did not go idle\n", s->pid);
+        } else if (node->pid > 0) {
+            waitpid(node->pid, NULL, 0);
+        }
+    }
+    if (t->mode == PROCTREE_CLONE_VM) {
+        for (int i = 1; i < t->n; i++) {
+            if (proctree_wait_word(&t->nodes[i].clear_tid, 0, &deadline) == -1) {
+                /* Leak the stacks rather than pull them from under a node. */
+                fprintf(stderr, "proctree: node %s (PID %d) has not exited\n",
+                        t->nodes[i].name, t->nodes[i].pid);
+                t->stacks = NULL;
+                break;
+            }
+        }
+    }
+    return killed;
+}
+
+static inline char *proctree_fanout_node(char *p, const int *fanout, int levels, int *next)
+{
+    p += sprintf(p, "n%d", (*next)++);
+    if (levels > 0 && fanout[0] > 0) {
+        *p++ = '(';
+        for (int i = 0; i < fanout[0]; i++) {
+            if (i > 0)
+                *p++ = ',';
+            p = proctree_fanout_node(p, fanout + 1, levels - 1, next);
+        }
+        *p++ = ')';
+        *p = '\0';
+    }
+    return p;
+}
+
+/* Parse a tree shape given as comma-separated per-level fan-outs, e.g.
+   "100,100", into fanout[] (room for PROCTREE_MAX_LEVELS). "0" is the
+   root alone, with no levels; otherwise every fan-out must be at least 1.
+   Returns the number of levels, or -1 if the shape is malformed or has
+   more than PROCTREE_MAX_SHAPE_NODES descendants. If nodes
+   is not NULL, the number of descendants of the root is stored there. */
+static inline int proctree_parse_shape(const char *shape, int *fanout, long *nodes)
+{
+    const char *p = shape;
+    long width = 1, total = 0;
+    int levels = 0;
+
+    if (strcmp(shape, "0") == 0) {
+        if (nodes)
+            *nodes = 0;
+        return 0;
+    }
+    for (;;) {
+        char *end;
+        long f = strtol(p, &end, 10);
+        if (end == p || f < 1 || levels == PROCTREE_MAX_LEVELS ||
+            f > PROCTREE_MAX_SHAPE_NODES / width)
+            return -1;
+        fanout[levels++] = (int)f;
+        width *= f;
+        total += width;
+        if (total > PROCTREE_MAX_SHAPE_NODES)
+            return -1;
+        if (*end == '\0')
+            break;
+        if (*end != ',')
+            return -1;
+        p = end + 1;
+    }
+    if (nodes)
+        *nodes = total;
+    return levels;
+}
+
+/* Spec of a regular tree given its per-level fan-outs: {3, 2} is a root
+   with 3 children that have 2 children each. Nodes are named n0, n1, ...
+   in spec order. Returns a malloc()ed string, or NULL. */
+static inline char *proctree_fanout_spec(const int *fanout, int levels)
+{
+    long nodes = 1, width = 1;
+    for (int l = 0; l < levels; l++) {
+        width *= fanout[l];
+        nodes += width;
+    }
+    /* "n" + up to 10 digits + one of '(' ',' ')' per node, and the ')'s. */
+    char *spec = malloc((size_t)nodes * 14 + 1);
+    int next = 0;
+    if (spec)
+        proctree_fanout_node(spec, fanout, levels, &next);
+    return spec;
+}
+
+/* For suites whose run() callback returns a failure count: the sum over
+   all live nodes, counting a node that never reported as one failure. */
+static inline int proctree_failures(const struct proctree *t)
+{
+    int failures = 0;
+    for (int i = 1; i < t->n; i++) {
+        if (t->nodes[i].dead)
+            continue;
+        const struct result_slot *s = results_get(t->results, i);
+        failures += s ? s->value : 1;
+    }
+    return failures;
+}
+
+/* Body of a pool stub: serve nodes until told to exit. */
+static inline int proctree_stub_main(void *arg)
+{
+    struct proctree_stub *s = arg;
+    for (;;) {
+        int state;
+        while ((state = atomic_load(&s->state)) == PROCTREE_STUB_IDLE)
+            proctree_futex(&s->state, FUTEX_WAIT, PROCTREE_STUB_IDLE, NULL);
+        if (state != PROCTREE_STUB_BUSY)
+            return 0;
+        proctree_run_node(s->tree, s->idx);
+        atomic_store(&s->state, PROCTREE_STUB_IDLE);
+        proctree_futex(&s->state, FUTEX_WAKE, 1, NULL);
+    }
+}
+
+/* Create `size` idle CLONE_VM stubs as children of the caller, which must
+   also be the process that spawns the trees using the pool.
+   Returns 0, or -1 with errno set. */
+static inline int proctree_pool_create(struct proctree_pool *pool, int size)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->stubs = calloc(size, sizeof(*pool->stubs));
+    pool->stacks_size = (size_t)size * PROCTREE_STACK_SIZE;
+    pool->stacks = mmap(NULL, pool->stacks_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (!pool->stubs || pool->stacks == MAP_FAILED) {
+        free(pool->stubs);
+        if (pool->stacks != MAP_FAILED)
+            munmap(pool->stacks, pool->stacks_size);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int i = 0; i < size; i++) {
+        struct proctree_stub *s = &pool->stubs[i];
+        atomic_init(&s->state, PROCTREE_STUB_IDLE);
+        s->clear_tid = 1;
+        s->pid = clone(proctree_stub_main, pool->stacks + (size_t)(i + 1) * PROCTREE_STACK_SIZE,
+                       CLONE_VM | CLONE_CHILD_CLEARTID | SIGCHLD, s, NULL, NULL, &s->clear_tid);
+        if (s->pid < 0)
+            break;
+        pool->size++;
+    }
+    return 0;
+}
+
+/* Tell every stub to exit and reap them. No tree may be using the pool. */
+static inline void proctree_pool_destroy(struct proctree_pool *pool)
+{
+    struct timespec deadline;
+    int leak = 0;
+
+    for (int i = 0; i < pool->size; i++) {
+        struct proctree_stub *s = &pool->stubs[i];
+        if (atomic_load(&s->state) == PROCTREE_STUB_IDLE) {
+            atomic_store(&s->state, PROCTREE_STUB_EXIT);
+            proctree_futex(&s->state, FUTEX_WAKE, 1, NULL);
+        } else {
+            kill(s->pid, SIGKILL);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += RESULTS_TIMEOUT_SEC;
+    for (int i = 0; i < pool->size; i++) {
+        waitpid(pool->stubs[i].pid, NULL, 0);
+        leak |= proctree_wait_word(&pool->stubs[i].clear_tid, 0, &deadline) == -1;
+    }
+    if (!leak)
+        munmap(pool->stacks, pool->stacks_size);
+    free(pool->stubs);
+    memset(pool, 0, sizeof(*pool));
+}
+
+#endif /* COMMON_PROCTREE_H */
@@ -0,0 +1,421 @@
+/* report.h
+
+   Machine-readable test results for the task suites.
+
+   Setting REPORT_FORMAT to tap, json or junit makes a suite also write
+   its results in that format, to REPORT_FILE or by default to
+   <suite>.tap, <suite>.json or <suite>.xml in the current directory. The
+   report has, for every test: its failures and monotonic-clock duration,
+   every check with its outcome, and every system call the test timed with
+   its duration, return value and errno. Without REPORT_FORMAT every call
+   below is a no-op.
+
+   Checks and system calls are made all over the process tree of a test
+   (and by the runner's workers), so each process appends one line per
+   event to a shared temporary file opened with O_APPEND, where small
+   writes do not interleave; report_close() turns that log into the final
+   report once every test has finished. The suite must call report_open()
+   before forking anything.
+
+       report_open("task1_tests");
+       ... report_test_begin(name); checks, syscalls; report_test_end(...) ...
+       report_close();
+
+   The runner (runner.h) calls report_test_begin()/report_test_end() for
+   every test when given them as its on_start/on_finish hooks.
+*/
+
+#ifndef COMMON_REPORT_H
+#define COMMON_REPORT_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { REPORT_OFF, REPORT_TAP, REPORT_JSON, REPORT_JUNIT };
+
+#define REPORT_NAME_MAX 128
+#define REPORT_LINE_MAX 1024
+
+static int report_format = REPORT_OFF;
+static int report_fd = -1;                  /* the shared event log */
+static char report_suite[REPORT_NAME_MAX];
+static char report_test[REPORT_NAME_MAX] = "main";  /* test this process works for */
+
+static inline uint64_t report_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Copy s into dst without the tabs and newlines that delimit log fields. */
+static inline void report_field(char *dst, size_t size, const char *s)
+{
+    size_t i = 0;
+    for (; s && *s && i + 1 < size; s++)
+        dst[i++] = *s == '\t' || *s == '\n' || *s == '\r' ? ' ' : *s;
+    dst[i] = '\0';
+}
+
+/* Append one line to the log in a single write(). */
+static inline void report_emit(const char *fmt, ...)
+{
+    char line[REPORT_LINE_MAX];
+    int saved_errno = errno;
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    if (len > (int)sizeof(line) - 2)
+        len = sizeof(line) - 2;
+    line[len++] = '\n';
+    /* A lost line only makes the report incomplete. */
+    ssize_t written = write(report_fd, line, len);
+    (void)written;
+    errno = saved_errno;
+}
+
+/* Read REPORT_FORMAT and set up the log. Call before forking. */
+static inline void report_open(const char *suite)
+{
+    const char *fmt = getenv("REPORT_FORMAT");
+    report_field(report_suite, sizeof(report_suite), suite);
+    if (!fmt || !*fmt)
+        return;
+    if (strcmp(fmt, "tap") == 0)
+        report_format = REPORT_TAP;
+    else if (strcmp(fmt, "json") == 0)
+        report_format = REPORT_JSON;
+    else if (strcmp(fmt, "junit") == 0)
+        report_format = REPORT_JUNIT;
+    else {
+        fprintf(stderr, "REPORT_FORMAT must be tap, json or junit, not \"%s\"\n", fmt);
+        return;
+    }
+    FILE *log = tmpfile();
+    if (!log) {
+        perror("report: tmpfile");
+        report_format = REPORT_OFF;
+        return;
+    }
+    report_fd = dup(fileno(log));
+    fclose(log);
+    fcntl(report_fd, F_SETFL, O_APPEND);
+}
+
+/* This process (and what it forks from now on) works for test name. */
+static inline void report_test_begin(const char *name)
+{
+    report_field(report_test, sizeof(report_test), name);
+}
+
+/* Record the outcome of test name: failures and duration. */
+static inline void report_test_end(const char *name, int failures, uint64_t duration_ns)
+{
+    char field[REPORT_NAME_MAX];
+    if (report_format == REPORT_OFF)
+        return;
+    report_field(field, sizeof(field), name);
+    report_emit("T\t%s\t%d\t%llu", field, failures, (unsigned long long)duration_ns);
+}
+
+/* Record a check of the current test; detail (printf-style, may be NULL)
+   says what went wrong. */
+static inline void report_check(const char *description, int ok, const char *detail, ...)
+{
+    char desc[REPORT_LINE_MAX / 2], msg[REPORT_LINE_MAX / 2], buf[REPORT_LINE_MAX / 2];
+    if (report_format == REPORT_OFF)
+        return;
+    buf[0] = '\0';
+    if (detail) {
+        va_list ap;
+        va_start(ap, detail);
+        vsnprintf(buf, sizeof(buf), detail, ap);
+        va_end(ap);
+    }
+    report_field(desc, sizeof(desc), description);
+    report_field(msg, sizeof(msg), buf);
+    report_emit("C\t%s\t%d\t%s\t%s", report_test, ok ? 1 : 0, desc, msg);
+}
+
+/* Record a system call of the current test that started at start_ns (from
+   report_now_ns()) and returned ret. Call it right after the syscall:
+   errno is read, and preserved. */
+static inline void report_syscall(const char *name, uint64_t start_ns, long ret)
+{
+    uint64_t end = report_now_ns();
+    if (report_format == REPORT_OFF)
+        return;
+    report_emit("S\t%s\t%s\t%llu\t%ld\t%d", report_test, name,
+                (unsigned long long)(end - start_ns), ret, ret == -1 ? errno : 0);
+}
+
+/* ---- writing the report ---- */
+
+struct report_event {
+    char type;              /* 'C' or 'S' */
+    const char *test;
+    const char *text;       /* description or syscall name */
+    const char *detail;     /* check detail */
+    int ok;
+    long ret;
+    int err;
+    unsigned long long ns;
+};
+
+struct report_entry {
+    const char *name;
+    int failures;           /* -1: no result recorded for the test */
+    unsigned long long ns;
+};
+
+static inline void report_put_escaped(FILE *out, const char *s, int xml)
+{
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (xml && c == '<')
+            fputs("&lt;", out);
+        else if (xml && c == '>')
+            fputs("&gt;", out);
+        else if (xml && c == '&')
+            fputs("&amp;", out);
+        else if (xml && c == '"')
+            fputs("&quot;", out);
+        else if (!xml && (c == '"' || c == '\\'))
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, xml ? "&#%d;" : "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+}
+
+static inline void report_write_tap(FILE *out, const struct report_entry *tests, int ntests,
+                                    const struct report_event *ev, int nev)
+{
+    fprintf(out, "TAP version 13\n1..%d\n", ntests);
+    for (int t = 0; t < ntests; t++) {
+        int n = 0, syscalls = 0;
+        fprintf(out, "# Subtest: %s\n", tests[t].name);
+        for (int i = 0; i < nev; i++) {
+            if (strcmp(ev[i].test, tests[t].name) != 0)
+                continue;
+            if (ev[i].type == 'S') {
+                syscalls++;
+                continue;
+            }
+            fprintf(out, "    %s %d - %s\n", ev[i].ok ? "ok" : "not ok", ++n, ev[i].text);
+            if (!ev[i].ok && *ev[i].detail)
+                fprintf(out, "    # %s\n", ev[i].detail);
+        }
+        fprintf(out, "    1..%d\n", n);
+        fprintf(out, "%s %d - %s\n  ---\n", tests[t].failures == 0 ? "ok" : "not ok", t + 1,
+                tests[t].name);
+        if (tests[t].failures >= 0)
+            fprintf(out, "  failures: %d\n  duration_ms: %.3f\n", tests[t].failures,
+                    tests[t].ns / 1e6);
+        if (syscalls) {
+            fprintf(out, "  syscalls:\n");
+            for (int i = 0; i < nev; i++)
+                if (ev[i].type == 'S' && strcmp(ev[i].test, tests[t].name) == 0)
+                    fprintf(out, "    - { name: %s, duration_ns: %llu, ret: %ld, errno: %d }\n",
+                            ev[i].text, ev[i].ns, ev[i].ret, ev[i].err);
+        }
+        fprintf(out, "  ...\n");
+    }
+}
+
+static inline void report_write_json(FILE *out, const struct report_entry *tests, int ntests,
+                                     const struct report_event *ev, int nev)
+{
+    fprintf(out, "{\"suite\": \"");
+    report_put_escaped(out, report_suite, 0);
+    fprintf(out, "\", \"tests\": [");
+    for (int t = 0; t < ntests; t++) {
+        fprintf(out, "%s\n  {\"name\": \"", t ? "," : "");
+        report_put_escaped(out, tests[t].name, 0);
+        if (tests[t].failures >= 0)
+            fprintf(out, "\", \"failures\": %d, \"duration_ns\": %llu", tests[t].failures,
+                    tests[t].ns);
+        else
+            fprintf(out, "\", \"failures\": null, \"duration_ns\": null");
+        for (int pass = 0; pass < 2; pass++) {
+            char type = pass == 0 ? 'C' : 'S';
+            int first = 1;
+            fprintf(out, ", \"%s\": [", pass == 0 ? "checks" : "syscalls");
+            for (int i = 0; i < nev; i++) {
+                if (ev[i].type != type || strcmp(ev[i].test, tests[t].name) != 0)
+                    continue;
+                fprintf(out, "%s\n    {\"%s\": \"", first ? "" : ",",
+                        type == 'C' ? "description" : "name");
+                report_put_escaped(out, ev[i].text, 0);
+                if (type == 'C') {
+                    fprintf(out, "\", \"ok\": %s, \"detail\": \"", ev[i].ok ? "true" : "false");
+                    report_put_escaped(out, ev[i].detail, 0);
+                    fprintf(out, "\"}");
+                } else {
+                    fprintf(out, "\", \"duration_ns\": %llu, \"ret\": %ld, \"errno\": %d}",
+                            ev[i].ns, ev[i].ret, ev[i].err);
+                }
+                first = 0;
+            }
+            fprintf(out, "%s]", first ? "" : "\n  ");
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n]}\n");
+}
+
+static inline void report_write_junit(FILE *out, const struct report_entry *tests, int ntests,
+                                      const struct report_event *ev, int nev)
+{
+    int failed = 0;
+    unsigned long long total = 0;
+    for (int t = 0; t < ntests; t++) {
+        failed += tests[t].failures != 0;
+        total += tests[t].failures >= 0 ? tests[t].ns : 0;
+    }
+    fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuite name=\"");
+    report_put_escaped(out, report_suite, 1);
+    fprintf(out, "\" tests=\"%d\" failures=\"%d\" time=\"%.6f\">\n", ntests, failed, total / 1e9);
+    for (int t = 0; t < ntests; t++) {
+        fprintf(out, "  <testcase classname=\"");
+        report_put_escaped(out, report_suite, 1);
+        fprintf(out, "\" name=\"");
+        report_put_escaped(out, tests[t].name, 1);
+        fprintf(out, "\" time=\"%.6f\">\n", tests[t].failures >= 0 ? tests[t].ns / 1e9 : 0.0);
+        for (int i = 0; i < nev; i++) {
+            if (ev[i].type != 'C' || ev[i].ok || strcmp(ev[i].test, tests[t].name) != 0)
+                continue;
+            fprintf(out, "    <failure message=\"");
+            report_put_escaped(out, ev[i].text, 1);
+            fprintf(out, "\">");
+            report_put_escaped(out, ev[i].detail, 1);
+            fprintf(out, "</failure>\n");
+        }
+        if (tests[t].failures < 0)
+            fprintf(out, "    <error message=\"no result recorded\"/>\n");
+        fprintf(out, "    <system-out>");
+        for (int i = 0; i < nev; i++) {
+            if (strcmp(ev[i].test, tests[t].name) != 0)
+                continue;
+            if (ev[i].type == 'C') {
+                fprintf(out, "\n[%s] ", ev[i].ok ? "PASS" : "FAIL");
+                report_put_escaped(out, ev[i].text, 1);
+            } else {
+                fprintf(out, "\nsyscall %s: %llu ns, ret %ld, errno %d", ev[i].text, ev[i].ns,
+                        ev[i].ret, ev[i].err);
+            }
+        }
+        fprintf(out, "\n    </system-out>\n  </testcase>\n");
+    }
+    fprintf(out, "</testsuite>\n");
+}
+
+/* Split a log line at tabs into at most n fields. Returns the count. */
+static inline int report_split(char *line, char **fields, int n)
+{
+    int k = 0;
+    fields[k++] = line;
+    for (char *p = line; *p && k < n; p++) {
+        if (*p == '\t') {
+            *p = '\0';
+            fields[k++] = p + 1;
+        }
+    }
+    return k;
+}
+
+/* Write the report from the log. Returns 0, or -1 if it cannot be written. */
+static inline int report_close(void)
+{
+    if (report_format == REPORT_OFF)
+        return 0;
+
+    off_t size = lseek(report_fd, 0, SEEK_END);
+    char *log = malloc(size + 1);
+    struct report_event *ev = calloc(size / 4 + 1, sizeof(*ev));
+    struct report_entry *tests = calloc(size / 4 + 1, sizeof(*tests));
+    int nev = 0, ntests = 0, ret = -1;
+    if (!log || !ev || !tests || pread(report_fd, log, size, 0) != size)
+        goto out;
+    log[size] = '\0';
+
+    /* Tests in the order their results were recorded, then any test that
+       only has events. */
+    for (char *line = log, *next; *line; line = next) {
+        char *f[6];
+        /* The last line may lack its newline after a short write or a
+           writer killed mid-line: it then runs to the end of the log. */
+        next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        else
+            next = line + strlen(line);
+        int k = report_split(line, f, 6);
+        if (f[0][0] == 'T' && k == 4) {
+            tests[ntests].name = f[1];
+            tests[ntests].failures = atoi(f[2]);
+            tests[ntests].ns = strtoull(f[3], NULL, 10);
+            ntests++;
+        } else if (f[0][0] == 'C' && k == 5) {
+            ev[nev] = (struct report_event){ .type = 'C', .test = f[1], .ok = atoi(f[2]),
+                                             .text = f[3], .detail = f[4] };
+            nev++;
+        } else if (f[0][0] == 'S' && k == 6) {
+            ev[nev] = (struct report_event){ .type = 'S', .test = f[1], .text = f[2],
+                                             .ns = strtoull(f[3], NULL, 10),
+                                             .ret = atol(f[4]), .err = atoi(f[5]) };
+            nev++;
+        }
+    }
+    for (int i = 0; i < nev; i++) {
+        int t = 0;
+        while (t < ntests && strcmp(tests[t].name, ev[i].test) != 0)
+            t++;
+        if (t == ntests)
+            tests[ntests++] = (struct report_entry){ ev[i].test, -1, 0 };
+    }
+
+    char path[REPORT_NAME_MAX + 8];
+    const char *file = getenv("REPORT_FILE");
+    if (!file || !*file) {
+        snprintf(path, sizeof(path), "%s.%s", report_suite,
+                 report_format == REPORT_TAP ? "tap" : report_format == REPORT_JSON ? "json" : "xml");
+        file = path;
+    }
+    FILE *out = fopen(file, "w");
+    if (!out) {
+        perror(file);
+        goto out;
+    }
+    if (report_format == REPORT_TAP)
+        report_write_tap(out, tests, ntests, ev, nev);
+    else if (report_format == REPORT_JSON)
+        report_write_json(out, tests, ntests, ev, nev);
+    else
+        report_write_junit(out, tests, ntests, ev, nev);
+    ret = fclose(out) == 0 ? 0 : -1;
+    if (ret == 0)
+        printf("Wrote %s\n", file);
+
+out:
+    if (ret == -1 && (!log || !ev || !tests))
+        perror("report");
+    free(log);
+    free(ev);
+    free(tests);
+    close(report_fd);
+    report_fd = -1;
+    report_format = REPORT_OFF;
+    return ret;
+}
+
+#endif /* COMMON_REPORT_H */
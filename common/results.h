@@ -0,0 +1,139 @@
+/* results.h
+
+   A shared-memory results table for descendants to report back to the
+   test process, replacing one pipe per descendant.
+
+   The table lives in a MAP_SHARED mapping created before the fork()s and
+   holds one slot per node id. A descendant fills in its slot (pid, value,
+   status) and publishes it with a release store; the parent waits once for
+   the expected number of reports and then reads whatever slots it needs
+   with acquire loads. Reporting costs a futex wake at most, however many
+   processes there are, and a slot can never be half-read the way a short
+   pipe read can.
+
+       struct results *r = results_create(n);     before forking
+       results_report(r, id, getpid(), nice, 0);  in descendant `id`
+       results_wait(r, count);                    in the parent
+       const struct result_slot *s = results_get(r, id);
+
+   Every slot may be reported at most once per round; results_reset()
+   starts a new round.
+*/
+
+#ifndef COMMON_RESULTS_H
+#define COMMON_RESULTS_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* How long results_wait() waits for missing reports. */
+#define RESULTS_TIMEOUT_SEC 10
+
+struct result_slot {
+    atomic_int ready;   /* 1 once the fields below are published */
+    pid_t pid;
+    int value;
+    int status;
+};
+
+struct results {
+    atomic_int reported;        /* number of slots published this round */
+    int nslots;
+    size_t size;                /* size of the mapping */
+    struct result_slot slots[];
+};
+
+/* Map a zeroed table with nslots slots, shared with all future children.
+   Returns NULL (with errno set) on failure. */
+static inline struct results *results_create(int nslots)
+{
+    size_t size = sizeof(struct results) + (size_t)nslots * sizeof(struct result_slot);
+    struct results *r = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED)
+        return NULL;
+    r->nslots = nslots;
+    r->size = size;
+    return r;
+}
+
+static inline void results_destroy(struct results *r)
+{
+    if (r)
+        munmap(r, r->size);
+}
+
+/* Clear every slot for the next round. Only valid once no process from the
+   previous round can still report. */
+static inline void results_reset(struct results *r)
+{
+    memset(r->slots, 0, (size_t)r->nslots * sizeof(struct result_slot));
+    atomic_store(&r->reported, 0);
+}
+
+/* Publish the result of node id. Returns 0, or -1 with errno == EINVAL if
+   id is out of range. */
+static inline int results_report(struct results *r, int id, pid_t pid, int value, int status)
+{
+    if (id < 0 || id >= r->nslots) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct result_slot *s = &r->slots[id];
+    s->pid = pid;
+    s->value = value;
+    s->status = status;
+    atomic_store_explicit(&s->ready, 1, memory_order_release);
+    atomic_fetch_add_explicit(&r->reported, 1, memory_order_release);
+    syscall(SYS_futex, &r->reported, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    return 0;
+}
+
+/* Block until at least n slots have been reported this round.
+   Returns 0, or -1 with errno == ETIMEDOUT after RESULTS_TIMEOUT_SEC. */
+static inline int results_wait(struct results *r, int n)
+{
+    struct timespec now, deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += RESULTS_TIMEOUT_SEC;
+
+    for (;;) {
+        int seen = atomic_load_explicit(&r->reported, memory_order_acquire);
+        if (seen >= n)
+            return 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        struct timespec left = {
+            .tv_sec = deadline.tv_sec - now.tv_sec,
+            .tv_nsec = deadline.tv_nsec - now.tv_nsec,
+        };
+        if (left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000L;
+        }
+        if (left.tv_sec < 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        syscall(SYS_futex, &r->reported, FUTEX_WAIT, seen, &left, NULL, 0);
+    }
+}
+
+/* The slot of node id, or NULL if it has not been reported. */
+static inline const struct result_slot *results_get(struct results *r, int id)
+{
+    if (id < 0 || id >= r->nslots)
+        return NULL;
+    const struct result_slot *s = &r->slots[id];
+    return atomic_load_explicit(&s->ready, memory_order_acquire) ? s : NULL;
+}
+
+#endif /* COMMON_RESULTS_H */
@@ -0,0 +1,269 @@
+/* runner.h
+
+   Parallel, isolated test runner shared by the task suites.
+
+   Each test case is run in its own forked worker process, so that state a
+   test leaves behind (nice values, stray descendants, the shared latch)
+   cannot leak into the next one, and so that independent cases can run
+   concurrently on every core. The runner:
+
+     - forks up to `jobs` workers at a time, optionally each in a fresh PID
+       namespace (falling back to a plain fork when that is not permitted);
+     - puts every worker in its own process group and, once the worker has
+       exited, SIGKILLs whatever is left in that group;
+     - optionally marks itself PR_SET_CHILD_SUBREAPER so orphans from a
+       worker's tree are reaped here instead of lingering under init;
+     - captures each worker's stdout/stderr in a temporary file and prints
+       the logs in test order once everything has finished, followed by a
+       one-line result per test.
+
+   A test function returns its number of failures; the worker exits with
+   that count (capped at 255).
+
+   Include this after defining _GNU_SOURCE (needed for CLONE_NEWPID).
+
+   Note that the subreaper and PID-namespace options change how orphans are
+   reparented, so suites that test reparenting (task1) must leave them off.
+*/
+
+#ifndef COMMON_RUNNER_H
+#define COMMON_RUNNER_H
+
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+struct runner_test {
+    const char *name;
+    int (*fn)(void);
+};
+
+struct runner_opts {
+    int jobs;                /* max concurrent workers; <= 0 means all online CPUs */
+    int new_pidns;           /* run each worker in its own PID namespace */
+    int subreaper;           /* make the runner a child subreaper */
+    void (*setup)(void);     /* called in each worker before the test, may be NULL */
+    /* Optional per-test hooks, e.g. report_test_begin/report_test_end
+       (report.h): on_start runs where the test runs, just before it;
+       on_finish runs in the runner with the test's result, in test order. */
+    void (*on_start)(const char *name);
+    void (*on_finish)(const char *name, int failures, uint64_t duration_ns);
+};
+
+struct runner_slot {
+    pid_t pid;
+    FILE *log;
+    int failures;
+    int done;
+    struct timespec start;
+    double ms;
+};
+
+static inline double runner_elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 +
+           (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* fork(), or a fork-like clone() into a new PID namespace if requested and
+   permitted. */
+static inline pid_t runner_fork(int new_pidns)
+{
+    if (new_pidns) {
+        pid_t pid = syscall(SYS_clone, CLONE_NEWPID | SIGCHLD, NULL, NULL, NULL, NULL);
+        if (pid != -1 || (errno != EPERM && errno != EINVAL))
+            return pid;
+    }
+    return fork();
+}
+
+static inline void runner_start(const struct runner_test *t, struct runner_slot *s,
+                                const struct runner_opts *opts)
+{
+    s->log = tmpfile();
+    if (!s->log) {
+        perror("tmpfile");
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    clock_gettime(CLOCK_MONOTONIC, &s->start);
+
+    pid_t pid = runner_fork(opts->new_pidns);
+    if (pid == -1) {
+        perror("fork (worker)");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        dup2(fileno(s->log), STDOUT_FILENO);
+        dup2(fileno(s->log), STDERR_FILENO);
+        /* The log is a regular file; keep stdout line buffered so output
+           pending at fork() time is not duplicated into descendants. */
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        if (opts->setup)
+            opts->setup();
+        if (opts->on_start)
+            opts->on_start(t->name);
+        int failures = t->fn();
+        fflush(stdout);
+        _exit(failures > 255 ? 255 : failures);
+    }
+    /* Also set it from this side so the group exists before we could
+       need to kill it. */
+    setpgid(pid, pid);
+    s->pid = pid;
+}
+
+/* Reap one exited child. Returns the index of the worker it belonged to,
+   or -1 if it was an adopted orphan. */
+static inline int runner_reap(struct runner_slot *slots, size_t n)
+{
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) == -1)
+        return -2;
+
+    for (size_t i = 0; i < n; i++) {
+        if (slots[i].pid != info.si_pid || slots[i].done)
+            continue;
+        /* Kill leftovers in the worker's group while its pid (and hence
+           the group id) is still pinned by the unreaped zombie. */
+        kill(-info.si_pid, SIGKILL);
+        int status;
+        waitpid(info.si_pid, &status, 0);
+        slots[i].done = 1;
+        slots[i].ms = runner_elapsed_ms(&slots[i].start);
+        if (WIFEXITED(status))
+            slots[i].failures = WEXITSTATUS(status);
+        else
+            slots[i].failures = 1;  /* crashed or killed */
+        return (int)i;
+    }
+    waitpid(info.si_pid, NULL, 0);
+    return -1;
+}
+
+/* Run all tests and return the total number of failures. */
+static inline int runner_run(const struct runner_test *tests, size_t n,
+                             const struct runner_opts *opts)
+{
+    int jobs = opts->jobs > 0 ? opts->jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1)
+        jobs = 1;
+
+    struct runner_slot *slots = calloc(n, sizeof(*slots));
+    if (!slots) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    if (opts->subreaper && prctl(PR_SET_CHILD_SUBREAPER, 1) == -1)
+        perror("prctl(PR_SET_CHILD_SUBREAPER)");
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t next = 0, finished = 0;
+    int running = 0;
+    while (finished < n) {
+        while (next < n && running < jobs) {
+            runner_start(&tests[next], &slots[next], opts);
+            next++;
+            running++;
+        }
+        int idx = runner_reap(slots, n);
+        if (idx == -2) {
+            perror("waitid");
+            exit(EXIT_FAILURE);
+        }
+        if (idx >= 0) {
+            running--;
+            finished++;
+        }
+    }
+    /* Adopted orphans that outlived their worker. */
+    if (opts->subreaper)
+        while (waitpid(-1, NULL, WNOHANG) > 0)
+            ;
+
+    int total = 0;
+    char buf[4096];
+    size_t len;
+    for (size_t i = 0; i < n; i++) {
+        rewind(slots[i].log);
+        while ((len = fread(buf, 1, sizeof(buf), slots[i].log)) > 0)
+            fwrite(buf, 1, len, stdout);
+        fclose(slots[i].log);
+        total += slots[i].failures;
+    }
+
+    printf("\nResults (%d worker(s), %.1f ms wall):\n", jobs, runner_elapsed_ms(&start));
+    for (size_t i = 0; i < n; i++) {
+        if (slots[i].failures == 0)
+            printf("[PASS] %s (%.1f ms)\n", tests[i].name, slots[i].ms);
+        else
+            printf("[FAIL] %s: %d failure(s) (%.1f ms)\n", tests[i].name,
+                   slots[i].failures, slots[i].ms);
+        if (opts->on_finish)
+            opts->on_finish(tests[i].name, slots[i].failures, (uint64_t)(slots[i].ms * 1e6));
+    }
+    free(slots);
+    return total;
+}
+
+/* Run all tests one after another in the calling process, as the suites
+   originally did. */
+static inline int runner_run_serial(const struct runner_test *tests, size_t n,
+                                    const struct runner_opts *opts)
+{
+    int total = 0;
+    if (opts->setup)
+        opts->setup();
+    for (size_t i = 0; i < n; i++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (opts->on_start)
+            opts->on_start(tests[i].name);
+        int failures = tests[i].fn();
+        total += failures;
+        if (opts->on_finish)
+            opts->on_finish(tests[i].name, failures,
+                            (uint64_t)(runner_elapsed_ms(&start) * 1e6));
+    }
+    return total;
+}
+
+/* Parse the common runner flags: -s (serial, in-process) and -j N.
+   Returns 1 if the serial runner was requested. */
+static inline int runner_parse_args(int argc, char **argv, struct runner_opts *opts)
+{
+    int serial = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "sj:")) != -1) {
+        switch (opt) {
+        case 's':
+            serial = 1;
+            break;
+        case 'j':
+            opts->jobs = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s] [-j jobs]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return serial;
+}
+
+#endif /* COMMON_RUNNER_H */
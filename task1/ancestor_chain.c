@@ -0,0 +1,280 @@
+/* ancestor_chain.c
+
+   Implementation of the lineage queries declared in ancestor_chain.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+#include "ancestor_chain.h"
+#include "ancestor_pid_proc.h"
+
+#ifndef SYS_ANCESTOR_PID
+#define SYS_ANCESTOR_PID 463
+#endif
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+/* Direct-mapped cache: a colliding insert evicts the previous entry. */
+#define CACHE_SLOTS 1024
+
+/* Give up re-walking after this many concurrent changes to the chain. */
+#define MAX_RETRIES 8
+
+struct cache_entry {
+    pid_t pid;      /* 0 when the slot is empty */
+    pid_t parent;   /* -1 until the parent link has been resolved */
+    int pidfd;      /* keeps track of whether pid is still the same process */
+};
+
+static struct cache_entry cache[CACHE_SLOTS];
+static int cache_entries;
+static int cache_limit = -1;    /* max pidfds the cache may hold */
+static int caching = 1;
+static enum ancestor_chain_strategy strategy = ANCESTOR_CHAIN_AUTO;
+static int resolved_strategy = -1;
+static struct ancestor_chain_stats stats;
+
+/* ---------------------------------------------------------------------
+   Parent lookups
+   --------------------------------------------------------------------- */
+
+static int syscall_available(void)
+{
+    return syscall(SYS_ANCESTOR_PID, 0, 0) == getpid();
+}
+
+/* Immediate parent of pid (0 for init), or -1 with errno set. */
+static pid_t lookup_parent(pid_t pid)
+{
+    if (resolved_strategy < 0) {
+        if (strategy == ANCESTOR_CHAIN_AUTO)
+            resolved_strategy = syscall_available() ? ANCESTOR_CHAIN_SYSCALL
+                                                    : ANCESTOR_CHAIN_PROC;
+        else
+            resolved_strategy = strategy;
+    }
+    stats.misses++;
+    if (resolved_strategy == ANCESTOR_CHAIN_SYSCALL)
+        return syscall(SYS_ANCESTOR_PID, pid, 1);
+    return ancestor_pid_proc_parent(pid);
+}
+
+/* ---------------------------------------------------------------------
+   Cache
+   --------------------------------------------------------------------- */
+
+static int pidfd_open(pid_t pid)
+{
+    return syscall(SYS_pidfd_open, pid, 0);
+}
+
+static void cache_evict(struct cache_entry *e)
+{
+    if (e->pid) {
+        close(e->pidfd);
+        e->pid = 0;
+        cache_entries--;
+    }
+}
+
+void ancestor_chain_cache_clear(void)
+{
+    for (int i = 0; i < CACHE_SLOTS; i++)
+        cache_evict(&cache[i]);
+}
+
+static struct cache_entry *cache_find(pid_t pid)
+{
+    struct cache_entry *e = &cache[pid % CACHE_SLOTS];
+    return e->pid == pid ? e : NULL;
+}
+
+/* Insert pid with a fresh pidfd. Returns NULL if it could not be cached. */
+static struct cache_entry *cache_insert(pid_t pid)
+{
+    if (cache_limit < 0) {
+        /* Never use more than half of the descriptor budget. */
+        struct rlimit rl;
+        cache_limit = CACHE_SLOTS;
+        if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur / 2 < CACHE_SLOTS)
+            cache_limit = rl.rlim_cur / 2;
+    }
+
+    struct cache_entry *e = &cache[pid % CACHE_SLOTS];
+    if (e->pid == pid)
+        return e;
+    cache_evict(e);
+    if (cache_entries >= cache_limit)
+        return NULL;
+
+    int fd = pidfd_open(pid);
+    if (fd < 0)
+        return NULL;
+    e->pid = pid;
+    e->parent = -1;
+    e->pidfd = fd;
+    cache_entries++;
+    return e;
+}
+
+/* Follow cached links from pid and check, with one poll(), that none of
+   the processes involved has exited. Fills out[] as far as the cache
+   reaches and returns the number of entries, or 0 if anything was stale
+   (stale entries are evicted). */
+static size_t cache_walk(pid_t pid, pid_t *out, size_t max)
+{
+    static struct pollfd fds[CACHE_SLOTS];
+    static struct cache_entry *ents[CACHE_SLOTS];
+    size_t n = 0, nfds = 0;
+
+    struct cache_entry *e = cache_find(pid);
+    while (e && n < max && nfds < CACHE_SLOTS) {
+        out[n++] = e->pid;
+        fds[nfds].fd = e->pidfd;
+        fds[nfds].events = POLLIN;
+        fds[nfds].revents = 0;
+        ents[nfds++] = e;
+        if (e->parent < 0)
+            break;
+        if (e->parent == 0) {
+            if (n < max)
+                out[n++] = 0;
+            break;
+        }
+        /* The link is only trusted while the parent is held too. */
+        struct cache_entry *parent = cache_find(e->parent);
+        if (!parent) {
+            e->parent = -1;
+            break;
+        }
+        e = parent;
+    }
+    if (nfds == 0)
+        return 0;
+
+    /* A pidfd becomes readable once its process has exited. */
+    if (poll(fds, nfds, 0) > 0) {
+        for (size_t i = 0; i < nfds; i++) {
+            if (!fds[i].revents)
+                continue;
+            /* The exited process's child (previous entry) now has a new
+               parent, so its link is stale as well. */
+            if (i > 0)
+                ents[i - 1]->parent = -1;
+            cache_evict(ents[i]);
+            stats.invalidations++;
+        }
+        return 0;
+    }
+    stats.hits += n;
+    return n;
+}
+
+/* ---------------------------------------------------------------------
+   Public API
+   --------------------------------------------------------------------- */
+
+static ssize_t walk_uncached(pid_t pid, pid_t *out, size_t max)
+{
+    size_t n = 0;
+    pid_t p = pid;
+    while (n < max) {
+        out[n++] = p;
+        if (p == 0)
+            break;
+        p = lookup_parent(p);
+        if (p < 0) {
+            if (n == 1)
+                return -1;
+            /* An ancestor exited under us; the caller retries. */
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    return n;
+}
+
+static ssize_t walk_cached(pid_t pid, pid_t *out, size_t max)
+{
+    size_t n = cache_walk(pid, out, max);
+    if (n > 0 && (out[n - 1] == 0 || n == max))
+        return n;
+
+    /* Resolve the rest, starting from the last trusted entry. */
+    if (n == 0) {
+        out[n++] = pid;
+        cache_insert(pid);
+    }
+    pid_t p = out[n - 1];
+    while (n < max && p != 0) {
+        pid_t parent = lookup_parent(p);
+        if (parent < 0) {
+            if (n == 1)
+                return -1;
+            errno = EAGAIN;
+            return -1;
+        }
+        /* Insert the parent first: it may evict p from a shared slot. */
+        struct cache_entry *pe = parent > 0 ? cache_insert(parent) : NULL;
+        struct cache_entry *e = cache_find(p);
+        if (e && parent == 0) {
+            e->parent = 0;
+        } else if (e && pe) {
+            /* Re-check the link now that the parent is held by a pidfd, in
+               case it exited (and its pid was reused) before we opened it. */
+            if (lookup_parent(p) == parent)
+                e->parent = parent;
+        }
+        out[n++] = parent;
+        p = parent;
+    }
+    return n;
+}
+
+ssize_t ancestor_chain(pid_t pid, pid_t *out, size_t max)
+{
+    if (pid < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (pid == 0)
+        pid = getpid();
+    if (max == 0)
+        return 0;
+
+    for (int attempt = 0; attempt < MAX_RETRIES; attempt++) {
+        ssize_t n = caching ? walk_cached(pid, out, max) : walk_uncached(pid, out, max);
+        if (n >= 0 || errno != EAGAIN)
+            return n;
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+void ancestor_chain_set_strategy(enum ancestor_chain_strategy s)
+{
+    strategy = s;
+    resolved_strategy = -1;
+    ancestor_chain_cache_clear();
+}
+
+void ancestor_chain_set_caching(int enabled)
+{
+    caching = enabled;
+    if (!enabled)
+        ancestor_chain_cache_clear();
+}
+
+void ancestor_chain_get_stats(struct ancestor_chain_stats *out)
+{
+    *out = stats;
+}
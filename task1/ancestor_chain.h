@@ -0,0 +1,63 @@
+/* ancestor_chain.h
+
+   Full-lineage queries built on sys_ancestor_pid (ID 463).
+
+   Calling syscall(SYS_ANCESTOR_PID, pid, n) for n = 0, 1, 2, ... until it
+   fails re-walks the chain from `pid` every time, so resolving a lineage of
+   depth d costs O(d^2) in the kernel. ancestor_chain() instead asks for the
+   immediate parent of each ancestor in turn (n == 1 on the previous
+   answer), which is O(d) in total, and caches parent links.
+
+   Every cached process is held by a pidfd. A parent link p -> q stays valid
+   for as long as both p and q are alive (p can only be reparented when q
+   exits), so a warm lookup validates the whole cached chain with a single
+   poll() over the pidfds instead of one syscall per level. Links whose
+   process has exited are dropped and re-resolved.
+
+   When the kernel lacks the syscall the parent links are read from
+   /proc/<pid>/stat instead.
+
+   The cache is per process and not thread-safe.
+
+   Compile ancestor_chain.c together with the program using it, e.g.:
+       gcc -O2 -Wall -o prog prog.c ancestor_chain.c
+*/
+
+#ifndef ANCESTOR_CHAIN_H
+#define ANCESTOR_CHAIN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+enum ancestor_chain_strategy {
+    ANCESTOR_CHAIN_AUTO,     /* syscall if available, else /proc */
+    ANCESTOR_CHAIN_SYSCALL,  /* always use SYS_ANCESTOR_PID */
+    ANCESTOR_CHAIN_PROC,     /* always read /proc/<pid>/stat */
+};
+
+struct ancestor_chain_stats {
+    unsigned long hits;           /* parent links served from the cache */
+    unsigned long misses;         /* parent links resolved from the kernel */
+    unsigned long invalidations;  /* cached links dropped because a process exited */
+};
+
+/* Write the lineage of pid into out: out[i] is what
+   syscall(SYS_ANCESTOR_PID, pid, i) would return, i.e. out[0] is pid
+   itself (getpid() when pid is 0) and the last entry is 0, the parent of
+   init. Returns the number of entries written, which is less than the full
+   lineage only if max is too small, or -1 with errno set (EINVAL for a
+   negative pid, ESRCH if pid does not exist). */
+ssize_t ancestor_chain(pid_t pid, pid_t *out, size_t max);
+
+/* Select how parent links are resolved. Clears the cache. */
+void ancestor_chain_set_strategy(enum ancestor_chain_strategy strategy);
+
+/* Enable or disable caching (enabled by default). Disabling clears it. */
+void ancestor_chain_set_caching(int enabled);
+
+/* Drop every cached link and close the pidfds held by the cache. */
+void ancestor_chain_cache_clear(void);
+
+void ancestor_chain_get_stats(struct ancestor_chain_stats *stats);
+
+#endif /* ANCESTOR_CHAIN_H */
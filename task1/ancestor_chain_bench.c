@@ -0,0 +1,176 @@
+/* ancestor_chain_bench.c
+
+   Compares resolving a full lineage with ancestor_chain() against the
+   naive loop of syscall(SYS_ANCESTOR_PID, pid, n) for n = 0, 1, 2, ...
+   (as call_ancestor() in test_ancestor_pid_gpt.c does).
+
+   A chain `depth` processes deep is built below this process; the leaf
+   then resolves its own lineage `iterations` times with:
+
+     naive     - one syscall per n, each re-walking from the leaf: O(d^2)
+     uncached  - ancestor_chain() with caching disabled: O(d)
+     cold      - ancestor_chain() with the cache cleared before every call
+     warm      - ancestor_chain() with a populated cache: one poll()
+
+   The results of every strategy are checked against each other first.
+   Without SYS_ANCESTOR_PID the naive loop is skipped and the library falls
+   back to /proc.
+
+   Compile with:
+       gcc -O2 -Wall -o ancestor_chain_bench ancestor_chain_bench.c ancestor_chain.c
+
+   Usage:
+       ./ancestor_chain_bench [-d depth] [-i iterations]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <string.h>
+#include "../common/bench.h"
+#include "ancestor_chain.h"
+
+#ifndef SYS_ANCESTOR_PID
+#define SYS_ANCESTOR_PID 463
+#endif
+
+#define MAX_LINEAGE 65536
+
+static int depth = 64;
+static long iterations = 10000;
+
+static pid_t expected[MAX_LINEAGE];
+static pid_t got[MAX_LINEAGE];
+
+/* The naive O(d^2) loop. Returns the number of entries, or -1. */
+static ssize_t naive_chain(pid_t pid, pid_t *out, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+        long ret = syscall(SYS_ANCESTOR_PID, pid, n);
+        if (ret < 0)
+            return errno == ESRCH && n > 0 ? (ssize_t)n : -1;
+        out[n++] = ret;
+        if (ret == 0)
+            break;
+    }
+    return n;
+}
+
+static int same_chain(const pid_t *a, ssize_t na, const pid_t *b, ssize_t nb) {
+    return na == nb && memcmp(a, b, na * sizeof(*a)) == 0;
+}
+
+static void report(const char *name, uint64_t ns, ssize_t len) {
+    double per_call = (double)ns / iterations;
+    printf("%-10s %12.2f us/lineage %10.1f ns/ancestor\n",
+           name, per_call / 1e3, per_call / len);
+}
+
+static int run_leaf(void) {
+    pid_t leaf = getpid();
+    int have_syscall = syscall(SYS_ANCESTOR_PID, 0, 0) == leaf;
+    uint64_t start;
+    ssize_t len;
+
+    /* Reference lineage, and agreement between all strategies. */
+    ancestor_chain_set_caching(0);
+    len = ancestor_chain(leaf, expected, MAX_LINEAGE);
+    if (len < 0) {
+        perror("ancestor_chain");
+        return EXIT_FAILURE;
+    }
+    if (have_syscall) {
+        ssize_t n = naive_chain(leaf, got, MAX_LINEAGE);
+        if (!same_chain(expected, len, got, n)) {
+            printf("[FAIL] ancestor_chain() and the naive loop disagree\n");
+            return EXIT_FAILURE;
+        }
+    }
+    ancestor_chain_set_caching(1);
+    for (int pass = 0; pass < 2; pass++) {
+        ssize_t n = ancestor_chain(leaf, got, MAX_LINEAGE);
+        if (!same_chain(expected, len, got, n)) {
+            printf("[FAIL] cached ancestor_chain() (pass %d) disagrees\n", pass);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("Lineage of %d: %zd entries (chain depth %d), %ld iterations, %s\n",
+           leaf, len, depth, iterations,
+           have_syscall ? "SYS_ANCESTOR_PID" : "/proc fallback");
+
+    if (have_syscall) {
+        start = bench_now_ns();
+        for (long i = 0; i < iterations; i++)
+            naive_chain(leaf, got, MAX_LINEAGE);
+        report("naive", bench_now_ns() - start, len);
+    } else {
+        printf("%-10s skipped: SYS_ANCESTOR_PID not available\n", "naive");
+    }
+
+    ancestor_chain_set_caching(0);
+    start = bench_now_ns();
+    for (long i = 0; i < iterations; i++)
+        ancestor_chain(leaf, got, MAX_LINEAGE);
+    report("uncached", bench_now_ns() - start, len);
+
+    ancestor_chain_set_caching(1);
+    start = bench_now_ns();
+    for (long i = 0; i < iterations; i++) {
+        ancestor_chain_cache_clear();
+        ancestor_chain(leaf, got, MAX_LINEAGE);
+    }
+    report("cold", bench_now_ns() - start, len);
+
+    ancestor_chain(leaf, got, MAX_LINEAGE);
+    start = bench_now_ns();
+    for (long i = 0; i < iterations; i++)
+        ancestor_chain(leaf, got, MAX_LINEAGE);
+    report("warm", bench_now_ns() - start, len);
+
+    struct ancestor_chain_stats st;
+    ancestor_chain_get_stats(&st);
+    printf("cache: %lu hits, %lu misses, %lu invalidations\n",
+           st.hits, st.misses, st.invalidations);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:i:")) != -1) {
+        switch (opt) {
+        case 'd': depth = atoi(optarg); break;
+        case 'i': iterations = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d depth] [-i iterations]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (depth < 0 || depth >= MAX_LINEAGE / 2 || iterations < 1) {
+        fprintf(stderr, "depth must be in [0, %d) and iterations >= 1\n", MAX_LINEAGE / 2);
+        return EXIT_FAILURE;
+    }
+
+    /* Build the chain: each parent waits for its child and passes on the
+       leaf's exit status. */
+    fflush(stdout);
+    for (int level = 0; level < depth; level++) {
+        pid_t child = fork();
+        if (child < 0) {
+            perror("fork");
+            _exit(EXIT_FAILURE);
+        }
+        if (child > 0) {
+            int status;
+            waitpid(child, &status, 0);
+            _exit(WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE);
+        }
+    }
+    int ret = run_leaf();
+    fflush(stdout);
+    _exit(ret);
+}
@@ -0,0 +1,235 @@
+/* ancestor_chain_depth.c
+
+   Deep process-chain generator for sys_ancestor_pid (ID 463) scaling tests.
+
+   Builds a linear chain main -> P1 -> P2 -> ... -> leaf that is `depth`
+   processes deep (thousands by default), then from the leaf:
+
+     1. verifies syscall(SYS_ANCESTOR_PID, leaf, k) against the recorded
+        chain for every k from 0 to depth;
+     2. times the syscall at evenly spaced k and fits a line through the
+        results, so the per-level cost of the ancestor walk is visible.
+
+   The requested depth is clamped so the chain fits within RLIMIT_NPROC
+   (for non-root users), pid_max and threads-max, leaving some headroom for
+   the rest of the system.
+
+   Compile with:
+       gcc -O2 -Wall -o ancestor_chain_depth ancestor_chain_depth.c
+
+   Usage:
+       ./ancestor_chain_depth [-d depth] [-p points] [-i iterations] [-c cpu]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <string.h>
+#include "../common/bench.h"
+
+#ifndef SYS_ANCESTOR_PID
+#define SYS_ANCESTOR_PID 463
+#endif
+
+/* Processes left free for everything else on the machine. */
+#define HEADROOM 64
+
+static int depth = 4000;
+static int points = 20;
+static long iterations = 10000;
+static int cpu = 0;
+
+/* chain[i] is the PID of the process i levels below main. */
+static pid_t *chain;
+
+static long read_long_file(const char *path) {
+    FILE *fp = fopen(path, "r");
+    long val = -1;
+    if (!fp)
+        return -1;
+    if (fscanf(fp, "%ld", &val) != 1)
+        val = -1;
+    fclose(fp);
+    return val;
+}
+
+/* Count the processes currently in /proc, and those owned by uid. */
+static void count_processes(uid_t uid, long *total, long *owned) {
+    DIR *dir = opendir("/proc");
+    struct dirent *de;
+    char path[300];
+    struct stat st;
+
+    *total = *owned = 0;
+    if (!dir)
+        return;
+    while ((de = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char)de->d_name[0]))
+            continue;
+        (*total)++;
+        snprintf(path, sizeof(path), "/proc/%s", de->d_name);
+        if (stat(path, &st) == 0 && st.st_uid == uid)
+            (*owned)++;
+    }
+    closedir(dir);
+}
+
+/* Largest chain depth the system limits allow right now. */
+static long max_chain_depth(void) {
+    long total, owned;
+    long limit = -1;
+    struct rlimit rl;
+
+    count_processes(getuid(), &total, &owned);
+
+    long pid_max = read_long_file("/proc/sys/kernel/pid_max");
+    if (pid_max > 0)
+        limit = pid_max - total - HEADROOM;
+
+    long threads_max = read_long_file("/proc/sys/kernel/threads-max");
+    if (threads_max > 0 && (limit < 0 || threads_max - total - HEADROOM < limit))
+        limit = threads_max - total - HEADROOM;
+
+    /* RLIMIT_NPROC is not enforced for root. */
+    if (getuid() != 0 && getrlimit(RLIMIT_NPROC, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        long nproc = (long)rl.rlim_cur - owned - HEADROOM;
+        if (limit < 0 || nproc < limit)
+            limit = nproc;
+    }
+    return limit;
+}
+
+static int run_leaf(void) {
+    pid_t leaf = getpid();
+    int mismatches = 0;
+
+    if (bench_pin_cpu(cpu) == -1)
+        fprintf(stderr, "Warning: could not pin to CPU %d: %s\n", cpu, strerror(errno));
+
+    /* 1. Verify every ancestor on the chain. */
+    for (int k = 0; k <= depth; k++) {
+        errno = 0;
+        long ret = syscall(SYS_ANCESTOR_PID, leaf, k);
+        if (ret != chain[depth - k]) {
+            if (mismatches < 10)
+                printf("[FAIL] ancestor_pid(leaf, %d): expected %d, got %ld (errno %d)\n",
+                       k, chain[depth - k], ret, errno);
+            mismatches++;
+        }
+    }
+    if (mismatches == 0)
+        printf("[PASS] ancestor_pid(leaf, k) matches the chain for all k in [0, %d]\n", depth);
+    else
+        printf("[FAIL] %d of %d ancestors did not match the chain\n", mismatches, depth + 1);
+
+    /* 2. Cost versus k. */
+    int npoints = points < 1 ? 1 : points;
+    double sum_k = 0, sum_t = 0, sum_kk = 0, sum_kt = 0;
+    printf("\n%8s %12s\n", "k", "ns/call");
+    for (int p = 0; p <= npoints; p++) {
+        int k = (int)((long)depth * p / npoints);
+        for (long i = 0; i < iterations / 10; i++)
+            syscall(SYS_ANCESTOR_PID, leaf, k);
+        uint64_t start = bench_now_ns();
+        for (long i = 0; i < iterations; i++)
+            syscall(SYS_ANCESTOR_PID, leaf, k);
+        double ns = (double)(bench_now_ns() - start) / iterations;
+        printf("%8d %12.1f\n", k, ns);
+
+        sum_k += k;
+        sum_t += ns;
+        sum_kk += (double)k * k;
+        sum_kt += k * ns;
+    }
+    int n = npoints + 1;
+    double denom = n * sum_kk - sum_k * sum_k;
+    if (denom > 0) {
+        double slope = (n * sum_kt - sum_k * sum_t) / denom;
+        double intercept = (sum_t - slope * sum_k) / n;
+        printf("\nLinear fit: %.1f ns + %.3f ns per ancestor level\n", intercept, slope);
+    }
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:p:i:c:")) != -1) {
+        switch (opt) {
+        case 'd': depth = atoi(optarg); break;
+        case 'p': points = atoi(optarg); break;
+        case 'i': iterations = atol(optarg); break;
+        case 'c': cpu = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d depth] [-p points] [-i iterations] [-c cpu]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (depth < 1 || iterations < 1) {
+        fprintf(stderr, "depth and iterations must be >= 1\n");
+        return EXIT_FAILURE;
+    }
+
+    long limit = max_chain_depth();
+    if (limit >= 0 && depth > limit) {
+        printf("Clamping chain depth from %d to %ld (RLIMIT_NPROC / pid_max / threads-max)\n",
+               depth, limit);
+        depth = (int)limit;
+    }
+    if (depth < 1) {
+        fprintf(stderr, "Not enough free processes to build a chain\n");
+        return EXIT_FAILURE;
+    }
+
+    chain = mmap(NULL, (depth + 1) * sizeof(*chain), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (chain == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    printf("Building a chain %d processes deep below %d...\n", depth, getpid());
+    uint64_t start = bench_now_ns();
+    fflush(stdout);
+
+    /* Each iteration forks one more level. The parent drops out of the loop
+       to wait for its child and pass on the leaf's exit status; the child
+       carries on building. */
+    int level = 0;
+    chain[0] = getpid();
+    while (level < depth) {
+        pid_t child = fork();
+        if (child < 0) {
+            perror("fork");
+            break;
+        }
+        if (child == 0) {
+            level++;
+            chain[level] = getpid();
+            continue;
+        }
+        int status;
+        waitpid(child, &status, 0);
+        if (level == 0) {
+            printf("Chain torn down.\n");
+            fflush(stdout);
+        }
+        _exit(WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE);
+    }
+    if (level < depth) {
+        /* fork failed part way: unwind the partial chain. */
+        _exit(EXIT_FAILURE);
+    }
+    printf("Chain built in %.1f ms\n", (bench_now_ns() - start) / 1e6);
+    int ret = run_leaf();
+    fflush(stdout);
+    _exit(ret);
+}
@@ -0,0 +1,205 @@
+/* ancestor_pid_bench.c
+
+   Latency microbenchmark for sys_ancestor_pid (ID 463).
+
+   Builds a linear chain of processes `depth` levels deep below this one
+   (main -> P1 -> ... -> leaf). The leaf pins itself to a CPU and, for every
+   n from 0 up to the chain depth, calls syscall(SYS_ANCESTOR_PID, leaf, n)
+   `iterations` times:
+
+     - once with every call individually timed, to report p50/p99/p99.9
+       latency (with the cost of reading the clock subtracted);
+     - once as a tight untimed loop, to report calls per second.
+
+   Every answer is checked once against the known chain before timing, so a
+   broken kernel is not benchmarked by accident. If the cost per call grows
+   linearly with n, the ancestor walk is O(n).
+
+   With -o the /proc reference implementation (ancestor_pid_proc.h) is
+   benchmarked side by side with the syscall, with 1/100th of the
+   iterations; on a kernel without the syscall only the oracle is run.
+
+   Compile with:
+       gcc -O2 -Wall -o ancestor_pid_bench ancestor_pid_bench.c
+
+   Usage:
+       ./ancestor_pid_bench [-d depth] [-i iterations] [-c cpu] [-o]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <string.h>
+#include "../common/bench.h"
+#include "ancestor_pid_proc.h"
+
+#ifndef SYS_ANCESTOR_PID
+#define SYS_ANCESTOR_PID 463
+#endif
+
+static int depth = 8;
+static long iterations = 1000000;
+static int cpu = 0;
+static int with_oracle = 0;
+
+/* chain[i] is the PID of the process i levels below main (chain[0] == main).
+   Shared so the leaf knows the expected answer for every n. */
+static pid_t *chain;
+
+typedef long (*ancestor_fn)(pid_t pid, unsigned int n);
+
+static long ancestor_syscall(pid_t pid, unsigned int n) {
+    return syscall(SYS_ANCESTOR_PID, pid, n);
+}
+
+struct path {
+    const char *name;
+    ancestor_fn fn;
+    long iterations;
+};
+
+/* Check every answer on the chain before timing anything. */
+static int verify_path(const struct path *p, pid_t leaf) {
+    for (int n = 0; n <= depth; n++) {
+        errno = 0;
+        long ret = p->fn(leaf, n);
+        if (ret != chain[depth - n]) {
+            fprintf(stderr, "%s: ancestor_pid(%d, %d) = %ld (errno %d), expected %d\n",
+                    p->name, leaf, n, ret, errno, chain[depth - n]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void bench_path(const struct path *p, pid_t leaf, int n,
+                       uint64_t *samples, uint64_t overhead) {
+    /* Warm up caches and the branch predictor. */
+    for (long i = 0; i < p->iterations / 100 + 1; i++)
+        p->fn(leaf, n);
+
+    for (long i = 0; i < p->iterations; i++) {
+        uint64_t t0 = bench_now_ns();
+        p->fn(leaf, n);
+        uint64_t t1 = bench_now_ns();
+        uint64_t d = t1 - t0;
+        samples[i] = d > overhead ? d - overhead : 0;
+    }
+    struct bench_summary s;
+    bench_summarize(samples, p->iterations, &s);
+
+    uint64_t start = bench_now_ns();
+    for (long i = 0; i < p->iterations; i++)
+        p->fn(leaf, n);
+    double secs = (bench_now_ns() - start) / 1e9;
+
+    printf("%-8s %5d %10llu %10llu %10llu %10.1f %14.0f\n", p->name, n,
+           (unsigned long long)s.p50, (unsigned long long)s.p99,
+           (unsigned long long)s.p999, s.mean, p->iterations / secs);
+    bench_metric(s.p50, "ancestor_pid.%s.n%d.p50_ns", p->name, n);
+    bench_metric(1e9 * secs / p->iterations, "ancestor_pid.%s.n%d.loop_ns", p->name, n);
+}
+
+static int run_bench(void) {
+    pid_t leaf = getpid();
+    struct path paths[2];
+    int npaths = 0;
+
+    if (bench_pin_cpu(cpu) == -1)
+        fprintf(stderr, "Warning: could not pin to CPU %d: %s\n", cpu, strerror(errno));
+
+    paths[npaths] = (struct path){ "syscall", ancestor_syscall, iterations };
+    if (verify_path(&paths[npaths], leaf) == 0)
+        npaths++;
+    else if (!with_oracle)
+        return EXIT_FAILURE;
+    else
+        fprintf(stderr, "SYS_ANCESTOR_PID not usable; benchmarking the oracle only\n");
+
+    if (with_oracle) {
+        /* The /proc walk is orders of magnitude slower; scale it down. */
+        long oracle_iterations = iterations / 100 > 100 ? iterations / 100 : 100;
+        paths[npaths] = (struct path){ "proc", ancestor_pid_proc, oracle_iterations };
+        if (verify_path(&paths[npaths], leaf) != 0)
+            return EXIT_FAILURE;
+        npaths++;
+    }
+
+    uint64_t *samples = malloc(iterations * sizeof(*samples));
+    if (!samples) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    uint64_t overhead = bench_clock_overhead_ns();
+    printf("Chain depth %d, %ld iterations per n, CPU %d, clock overhead %llu ns\n",
+           depth, iterations, cpu, (unsigned long long)overhead);
+    printf("%-8s %5s %10s %10s %10s %10s %14s\n",
+           "path", "n", "p50(ns)", "p99(ns)", "p999(ns)", "mean(ns)", "calls/s");
+
+    for (int n = 0; n <= depth; n++)
+        for (int i = 0; i < npaths; i++)
+            bench_path(&paths[i], leaf, n, samples, overhead);
+
+    free(samples);
+    return EXIT_SUCCESS;
+}
+
+/* Fork the rest of the chain below the calling process, which sits at
+   `level`. Every intermediate process just waits for its child and passes
+   on the leaf's exit status. */
+static int build_chain(int level) {
+    chain[level] = getpid();
+    if (level == depth) {
+        int ret = run_bench();
+        fflush(stdout);
+        return ret;
+    }
+
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return EXIT_FAILURE;
+    }
+    if (child == 0)
+        _exit(build_chain(level + 1));
+
+    int status;
+    if (waitpid(child, &status, 0) == -1) {
+        perror("waitpid");
+        return EXIT_FAILURE;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:i:c:o")) != -1) {
+        switch (opt) {
+        case 'o': with_oracle = 1; break;
+        case 'd': depth = atoi(optarg); break;
+        case 'i': iterations = atol(optarg); break;
+        case 'c': cpu = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d depth] [-i iterations] [-c cpu] [-o]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (depth < 0 || iterations < 1) {
+        fprintf(stderr, "depth must be >= 0 and iterations >= 1\n");
+        return EXIT_FAILURE;
+    }
+
+    chain = mmap(NULL, (depth + 1) * sizeof(*chain), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (chain == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    return build_chain(0);
+}
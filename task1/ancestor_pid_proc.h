@@ -0,0 +1,79 @@
+/* ancestor_pid_proc.h
+
+   Userspace reference implementation of sys_ancestor_pid (ID 463), built
+   on the PPid field of /proc/<pid>/stat.
+
+   It reproduces the documented semantics of the syscall:
+     - a negative pid fails with EINVAL;
+     - pid 0 means the calling process;
+     - n == 0 returns the process itself;
+     - each step moves to the parent; the parent of init is pid 0;
+     - asking for an ancestor past pid 0 (or of a process that does not
+       exist) fails with ESRCH.
+
+   Like syscall(2), ancestor_pid_proc() returns -1 and sets errno on error,
+   so it can be used as a differential oracle next to the syscall and lets
+   the task1 suite run on kernels without it.
+*/
+
+#ifndef ANCESTOR_PID_PROC_H
+#define ANCESTOR_PID_PROC_H
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Immediate parent of pid according to /proc (0 for init), or -1 with
+   errno == ESRCH if pid does not exist. */
+static inline pid_t ancestor_pid_proc_parent(pid_t pid)
+{
+    char path[64], buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        errno = ESRCH;
+        return -1;
+    }
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+
+    /* "pid (comm) state ppid ...": comm may contain spaces and parens, so
+       parse from the last ')'. */
+    char *p = strrchr(buf, ')');
+    int ppid;
+    if (!p || sscanf(p + 1, " %*c %d", &ppid) != 1) {
+        errno = ESRCH;
+        return -1;
+    }
+    return ppid;
+}
+
+static inline long ancestor_pid_proc(pid_t pid, unsigned int n)
+{
+    if (pid < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (pid == 0)
+        pid = getpid();
+
+    /* n == 0 still requires pid to exist. */
+    if (ancestor_pid_proc_parent(pid) < 0)
+        return -1;
+
+    pid_t cur = pid;
+    for (unsigned int i = 0; i < n; i++) {
+        if (cur == 0) {
+            errno = ESRCH;
+            return -1;
+        }
+        cur = ancestor_pid_proc_parent(cur);
+        if (cur < 0)
+            return -1;
+    }
+    return cur;
+}
+
+#endif /* ANCESTOR_PID_PROC_H */
@@ -0,0 +1,363 @@
+/* ancestor_pid_stress.c
+
+   Concurrency stress for sys_ancestor_pid (ID 463) while the process tree
+   keeps changing under it.
+
+   Churner processes (children of this one, each a child subreaper) cycle
+   a set of slots, each through:
+
+       fork an intermediate parent P, which forks a leaf L;  (L -> P -> churner)
+       kill P, so that L is reparented to the churner;        (L -> churner)
+       kill and reap L, and start over.
+
+   Meanwhile caller threads pick random live slots and call
+   syscall(SYS_ANCESTOR_PID, L, n) for random n. At any instant L's lineage
+   is one of
+
+       L, P, churner, main, <ancestors of main>, 0
+       L,    churner, main, <ancestors of main>, 0
+
+   so every answer must be the n-th entry of one of the two, or fail with
+   ESRCH. Anything else is reported as inconsistent. Every slot has a
+   sequence count, odd while the slot is being retired, which callers
+   re-check after the call: an answer is only judged if the slot did not
+   change around it, so that a reaped leaf's recycled PID can never be
+   mistaken for the leaf.
+
+   The report gives calls per second (total and per caller thread), slot
+   cycles per second, how many answers came back ESRCH, and how many were
+   inconsistent (the first few are printed). On kernels without the syscall
+   the /proc reference implementation is stressed instead, like task1_tests
+   does.
+
+   Compile with:
+       gcc -O2 -Wall -pthread -o ancestor_pid_stress ancestor_pid_stress.c
+
+   Usage:
+       ./ancestor_pid_stress [-d seconds] [-t callers] [-l leaves] [-c churners] [-h hold_us]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "../common/bench.h"
+#include "ancestor_pid_proc.h"
+
+#ifndef SYS_ANCESTOR_PID
+#define SYS_ANCESTOR_PID 463
+#endif
+
+#define MAX_LINEAGE 64
+#define MAX_REPORTED 10
+
+static double seconds = 5.0;
+static int ncallers = 0;
+static int nleaves = 64;
+static int nchurners = 2;
+static long hold_us = 200;
+
+static int use_oracle = 0;
+
+struct slot {
+    atomic_uint seq;        /* even: published leaf is live; odd: changing */
+    atomic_int leaf;
+    atomic_int parent;      /* P, while it is alive; 0 once killed */
+    atomic_int churner;
+    atomic_int pending;     /* leaf PID handed over by a new P */
+};
+
+struct shared {
+    atomic_int stop;
+    atomic_long cycles;
+    struct slot slots[];
+};
+
+static struct shared *sh;
+
+/* Lineage of this (main) process: main, its parent, ..., up to 0. */
+static pid_t main_lineage[MAX_LINEAGE];
+static int main_depth;
+
+static long ancestor_pid(pid_t pid, unsigned int n) {
+    if (use_oracle)
+        return ancestor_pid_proc(pid, n);
+    return syscall(SYS_ANCESTOR_PID, pid, n);
+}
+
+/* ---- churners ---- */
+
+static void sleep_us(long us) {
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+/* Start slot s over: fork P, which forks the leaf and hands its PID back. */
+static int slot_spawn(struct slot *s) {
+    atomic_store(&s->pending, 0);
+    pid_t p = fork();
+    if (p < 0)
+        return -1;
+    if (p == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        pid_t leaf = fork();
+        if (leaf == 0)
+            for (;;)
+                pause();
+        atomic_store(&s->pending, leaf > 0 ? leaf : -1);
+        for (;;)
+            pause();
+    }
+    while (atomic_load(&s->pending) == 0)
+        sched_yield();
+    pid_t leaf = atomic_load(&s->pending);
+    if (leaf < 0) {
+        kill(p, SIGKILL);
+        waitpid(p, NULL, 0);
+        return -1;
+    }
+    atomic_store(&s->leaf, leaf);
+    atomic_store(&s->parent, p);
+    atomic_store(&s->churner, getpid());
+    atomic_fetch_add(&s->seq, 1);           /* odd -> even: live */
+    return 0;
+}
+
+static void run_churner(int first, int count) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+    for (int i = first; i < first + count; i++)
+        if (slot_spawn(&sh->slots[i]) == -1)
+            _exit(EXIT_FAILURE);
+
+    while (!atomic_load(&sh->stop)) {
+        for (int i = first; i < first + count; i++) {
+            struct slot *s = &sh->slots[i];
+            pid_t p = atomic_load(&s->parent);
+            if (p) {
+                /* Orphan the leaf; it is reparented to us. */
+                kill(p, SIGKILL);
+                waitpid(p, NULL, 0);
+                atomic_store(&s->parent, 0);
+            } else {
+                /* Retire the leaf before its PID can be recycled. */
+                atomic_fetch_add(&s->seq, 1);   /* even -> odd */
+                pid_t leaf = atomic_load(&s->leaf);
+                kill(leaf, SIGKILL);
+                waitpid(leaf, NULL, 0);
+                if (slot_spawn(s) == -1)
+                    _exit(EXIT_FAILURE);
+                atomic_fetch_add(&sh->cycles, 1);
+            }
+        }
+        if (hold_us)
+            sleep_us(hold_us);
+    }
+
+    for (int i = first; i < first + count; i++) {
+        struct slot *s = &sh->slots[i];
+        atomic_fetch_add(&s->seq, 1);
+        if (atomic_load(&s->parent))
+            kill(atomic_load(&s->parent), SIGKILL);
+        kill(atomic_load(&s->leaf), SIGKILL);
+    }
+    while (wait(NULL) > 0)
+        ;
+    _exit(EXIT_SUCCESS);
+}
+
+/* ---- callers ---- */
+
+struct caller {
+    pthread_t thread;
+    unsigned int seed;
+    long calls, judged, raced, esrch, inconsistent;
+};
+
+static atomic_int reported;
+
+/* The n-th ancestor of a leaf whose lineage continues with `path` (P and
+   the churner, or just the churner) and then main's lineage; -1 if there
+   is none. */
+static pid_t expected(const pid_t *path, int npath, unsigned int n) {
+    if (n <= (unsigned int)npath)
+        return n == 0 ? -2 : path[n - 1];
+    n -= npath + 1;
+    return n < (unsigned int)main_depth ? main_lineage[n] : -1;
+}
+
+static void judge(struct caller *c, pid_t leaf, pid_t p, pid_t churner, unsigned int n,
+                  long ret, int err) {
+    pid_t with_p[2] = { p, churner }, orphan[1] = { churner };
+    if (ret == -1 && err == ESRCH) {
+        c->esrch++;
+        return;
+    }
+    if (ret != -1) {
+        if ((n == 0 && ret == leaf) ||
+            (n > 0 && p && expected(with_p, 2, n) == ret) ||
+            (n > 0 && expected(orphan, 1, n) == ret))
+            return;
+    }
+    c->inconsistent++;
+    if (atomic_fetch_add(&reported, 1) < MAX_REPORTED)
+        printf("[FAIL] ancestor_pid(%d, %u) = %ld (errno %d); leaf %d, parent %d, churner %d, "
+               "main %d\n", leaf, n, ret, ret == -1 ? err : 0, leaf, p, churner, main_lineage[0]);
+}
+
+static void *run_caller(void *arg) {
+    struct caller *c = arg;
+    unsigned int max_n = main_depth + 3;
+
+    while (!atomic_load_explicit(&sh->stop, memory_order_relaxed)) {
+        struct slot *s = &sh->slots[rand_r(&c->seed) % nleaves];
+        unsigned int n = rand_r(&c->seed) % (max_n + 1);
+
+        unsigned int seq = atomic_load(&s->seq);
+        if (seq & 1)
+            continue;
+        pid_t leaf = atomic_load(&s->leaf);
+        pid_t p = atomic_load(&s->parent);
+        pid_t churner = atomic_load(&s->churner);
+
+        errno = 0;
+        long ret = ancestor_pid(leaf, n);
+        int err = errno;
+        c->calls++;
+
+        /* P may have been killed since we read it: that only widens what
+           is valid, so judge against P as read. A changed sequence means
+           the leaf may be gone and its PID reused: no verdict. */
+        if (atomic_load(&s->seq) != seq) {
+            c->raced++;
+            continue;
+        }
+        c->judged++;
+        judge(c, leaf, p, churner, n, ret, err);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:l:c:h:")) != -1) {
+        switch (opt) {
+        case 'd': seconds = atof(optarg); break;
+        case 't': ncallers = atoi(optarg); break;
+        case 'l': nleaves = atoi(optarg); break;
+        case 'c': nchurners = atoi(optarg); break;
+        case 'h': hold_us = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d seconds] [-t callers] [-l leaves] [-c churners] "
+                    "[-h hold_us]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (ncallers <= 0)
+        ncallers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (seconds <= 0 || nchurners < 1 || nleaves < nchurners || hold_us < 0) {
+        fprintf(stderr, "seconds must be positive, leaves >= churners >= 1 and hold_us >= 0\n");
+        return EXIT_FAILURE;
+    }
+
+    use_oracle = syscall(SYS_ANCESTOR_PID, 0, 0) != getpid();
+    if (use_oracle)
+        printf("SYS_ANCESTOR_PID not available: stressing the /proc reference implementation.\n");
+
+    /* Our own lineage does not change during the run. */
+    for (main_depth = 0; main_depth < MAX_LINEAGE; main_depth++) {
+        long a = ancestor_pid(getpid(), main_depth);
+        if (a == -1)
+            break;
+        main_lineage[main_depth] = a;
+    }
+
+    size_t size = sizeof(*sh) + nleaves * sizeof(struct slot);
+    sh = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sh == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < nleaves; i++)
+        atomic_store(&sh->slots[i].seq, 1);
+
+    pid_t churners[nchurners];
+    for (int i = 0; i < nchurners; i++) {
+        int first = i * nleaves / nchurners, last = (i + 1) * nleaves / nchurners;
+        fflush(stdout);
+        churners[i] = fork();
+        if (churners[i] < 0) {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (churners[i] == 0)
+            run_churner(first, last - first);
+    }
+    /* Wait until every slot is live once. */
+    for (int i = 0; i < nleaves; i++)
+        while (atomic_load(&sh->slots[i].seq) == 1)
+            sched_yield();
+
+    printf("%d caller thread(s), %d leaves, %d churner(s), %.1f s, main lineage depth %d\n",
+           ncallers, nleaves, nchurners, seconds, main_depth);
+
+    struct caller *callers = calloc(ncallers, sizeof(*callers));
+    if (!callers) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    long cycles_before = atomic_load(&sh->cycles);
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < ncallers; i++) {
+        callers[i].seed = i + 1;
+        if (pthread_create(&callers[i].thread, NULL, run_caller, &callers[i]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    sleep_us((long)(seconds * 1e6));
+    atomic_store(&sh->stop, 1);
+
+    long calls = 0, judged = 0, raced = 0, esrch = 0, inconsistent = 0;
+    for (int i = 0; i < ncallers; i++) {
+        pthread_join(callers[i].thread, NULL);
+        calls += callers[i].calls;
+        judged += callers[i].judged;
+        raced += callers[i].raced;
+        esrch += callers[i].esrch;
+        inconsistent += callers[i].inconsistent;
+    }
+    double secs = (bench_now_ns() - t0) / 1e9;
+    long cycles = atomic_load(&sh->cycles) - cycles_before;
+
+    int status = EXIT_SUCCESS;
+    for (int i = 0; i < nchurners; i++) {
+        int st;
+        waitpid(churners[i], &st, 0);
+        if (!WIFEXITED(st) || WEXITSTATUS(st) != 0) {
+            fprintf(stderr, "churner %d failed\n", churners[i]);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    printf("calls:        %ld (%.0f/s, %.0f/s per caller)\n", calls, calls / secs,
+           calls / secs / ncallers);
+    printf("tree churn:   %ld leaf cycles (%.0f/s)\n", cycles, cycles / secs);
+    printf("answers:      %ld judged, %ld raced with a retirement, %ld ESRCH\n", judged, raced,
+           esrch);
+    printf("inconsistent: %ld\n", inconsistent);
+    bench_metric(calls ? 1e9 * secs * ncallers / calls : 0, "ancestor_pid_stress.%s.ns_per_call",
+                 use_oracle ? "proc" : "syscall");
+    munmap(sh, size);
+    return inconsistent || status != EXIT_SUCCESS ? EXIT_FAILURE : EXIT_SUCCESS;
+}
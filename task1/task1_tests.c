@@ -6,6 +6,10 @@
 #include <sys/wait.h>
 #include <errno.h>
 #include <string.h>
+#include "../common/proctree.h"
+#include "../common/report.h"
+#include "../common/runner.h"
+#include "ancestor_pid_proc.h"
 
 #ifndef SYS_ANCESTOR_PID
 #define SYS_ANCESTOR_PID 463
@@ -17,45 +21,108 @@
 static pid_t original_pid;
 static int tests_failed = 0;
 
+/* Number of harness processes inserted between the shell and original_pid:
+   0 when run serially, 1 when each test runs in a worker under the runner.
+   The init / pid 0 expectations in the chain-alive test shift by this. */
+static int extra_depth = 0;
+
+/* Set when the kernel lacks SYS_ANCESTOR_PID: the suite then runs against
+   the /proc reference implementation instead. */
+static int use_oracle = 0;
+
+long ancestor_pid(pid_t pid, unsigned int n) {
+    uint64_t start = report_now_ns();
+    long ret;
+    if (use_oracle) {
+        ret = ancestor_pid_proc(pid, n);
+        report_syscall("ancestor_pid_proc", start, ret);
+    } else {
+        ret = syscall(SYS_ANCESTOR_PID, pid, n);
+        report_syscall("ancestor_pid", start, ret);
+    }
+    return ret;
+}
+
 /*
  HELPER FUNCTIONS FOR PRINTING TEST RESULTS
 */
 void check_test(const char *description, long expected, long actual) {
     if (actual == expected) {
         printf("[PASS] %s\n", description);
+        report_check(description, 1, NULL);
     } else {
         printf("[FAIL] %s: expected %ld, got %ld\n", description, expected, actual);
+        report_check(description, 0, "expected %ld, got %ld", expected, actual);
         tests_failed++;
     }
 }
 
 void check_test_errno(const char *description, int expected_errno, long ret) {
-    if (ret == -1 && errno == expected_errno) {
+    int err = errno;
+    if (ret == -1 && err == expected_errno) {
         printf("[PASS] %s: got -1 and errno set to %d as expected.\n", description, expected_errno);
+        report_check(description, 1, NULL);
     } else {
-        printf("[FAIL] %s: expected -1 with errno %d, got %ld with errno %d\n", description, expected_errno, ret, errno);
+        printf("[FAIL] %s: expected -1 with errno %d, got %ld with errno %d\n", description, expected_errno, ret, err);
+        report_check(description, 0, "expected -1 with errno %d, got %ld with errno %d",
+                     expected_errno, ret, err);
         tests_failed++;
     }
 }
 
+/* Name of a chain check, built from the n actually queried so that it
+   stays right when extra_depth shifts it. Valid until the next call;
+   errno is preserved for check_test_errno(). */
+const char *chain_check_name(const char *chain, unsigned int n, const char *what) {
+    static char name[96];
+    int err = errno;
+    snprintf(name, sizeof(name), "%s chain: n==%u (%s)", chain, n, what);
+    errno = err;
+    return name;
+}
+
 /*
   BASIC TESTS
  */
-void basic_tests() {
+int basic_tests() {
     long ret;
+    int failed_before = tests_failed;
 
     printf("Running basic tests in process %d...\n", getpid());
 
     /* Test negative PID: should return -EINVAL */
     errno = 0;
-    ret = syscall(SYS_ANCESTOR_PID, -5, 0);
+    ret = ancestor_pid(-5, 0);
     check_test_errno("Negative PID (-5)", EINVAL, ret);
 
     /* Test using PID==0 for n==0: should return the calling process's PID */
     pid_t mypid = getpid();
     errno = 0;
-    ret = syscall(SYS_ANCESTOR_PID, 0, 0);
+    ret = ancestor_pid(0, 0);
     check_test("PID==0, n==0 (should return own PID)", mypid, ret);
+    return tests_failed - failed_before;
+}
+
+/* Run a tree built from spec whose nodes call fn once released, and add
+   their failures to tests_failed. */
+int run_tree(const char *spec, proctree_fn fn) {
+    struct proctree tree;
+    int failures;
+
+    if (proctree_create(&tree, spec) == -1) {
+        perror("proctree_create");
+        exit(EXIT_FAILURE);
+    }
+    if (proctree_spawn(&tree, NULL, fn, NULL) == -1) {
+        failures = 1;
+    } else {
+        proctree_release(&tree);
+        proctree_finish(&tree);
+        failures = proctree_failures(&tree);
+    }
+    proctree_destroy(&tree);
+    tests_failed += failures;
+    return failures;
 }
 
 /* Test with an alive chain:
@@ -70,174 +137,226 @@ void basic_tests() {
      - n==6 should return pid 0
      - n==7 should return -ESRCH (no such process)
 */
-void test_chain_alive() {
-    pid_t child_pid, grandchild_pid;
-    int status;
+int chain_alive_node(struct proctree *tree, int idx, void *arg) {
+    int failed_before = tests_failed;
+    (void)arg;
+
+    if (tree->nodes[idx].depth != 2)
+        return 0;
+
+    /* In grandchild process */
+    pid_t mypid = getpid();
+    pid_t parent_pid = getppid();
+    printf("Grandchild process %d: parent = %d, expected grandparent = %d\n", 
+           mypid, parent_pid, original_pid);
 
+    long ret;
+
+    /* Test n == 0 */
+    errno = 0;
+    ret = ancestor_pid(mypid, 0);
+    check_test(chain_check_name("Alive", 0, "self"), mypid, ret);
+
+    /* Test n == 1 */
+    errno = 0;
+    ret = ancestor_pid(mypid, 1);
+    check_test(chain_check_name("Alive", 1, "immediate parent"), parent_pid, ret);
+
+    /* Test n == 2 */
+    errno = 0;
+    ret = ancestor_pid(mypid, 2);
+    check_test(chain_check_name("Alive", 2, "grandparent"), original_pid, ret);
+
+    /* Test n == 3: nshould return the bash process’s PID */
+    printf("Skipping test for n==3 (bash process) because it is not guaranteed to be a static pid.\n");
+
+    /* Test n == 4: should return the login process’s PID */
+    printf("Skipping test for n==4 (login process) because it is not guaranteed to be a static pid.\n");
+
+    /* Test n == 5 + extra_depth: should return the init process’s PID */
+    errno = 0;
+    ret = ancestor_pid(mypid, 5 + extra_depth);
+    check_test(chain_check_name("Alive", 5 + extra_depth, "init process"), 1, ret);
+
+    /* Test n == 6 + extra_depth: should return pid 0 */
+    errno = 0;
+    ret = ancestor_pid(mypid, 6 + extra_depth);
+    check_test(chain_check_name("Alive", 6 + extra_depth, "pid 0"), 0, ret);
+
+    /* Test n == 7 + extra_depth: should return -ESRCH (no such process) */
+    errno = 0;
+    ret = ancestor_pid(mypid, 7 + extra_depth);
+    check_test_errno(chain_check_name("Alive", 7 + extra_depth, "no such process"), ESRCH, ret);
+
+    /* Report failures to the main process through the tree's results */
+    return tests_failed - failed_before;
+}
+
+int test_chain_alive() {
     printf("\n[Chain Alive Test] Starting chain with all ancestors alive...\n");
+    int failures = run_tree("main(child(grandchild))", chain_alive_node);
+    printf("[Chain Alive Test] Completed.\n");
+    return failures;
+}
 
-    child_pid = fork();
-    if (child_pid < 0) {
-        perror("fork");
-        exit(EXIT_FAILURE);
-    }
+/* Test with a broken chain:
+   In this test, the child forks a grandchild and exits before the
+   grandchild is released, so that the grandchild is orphaned. The tree
+   builder waits for the child to have exited, so no sleep is needed.
+*/
+int chain_broken_node(struct proctree *tree, int idx, void *arg) {
+    int failed_before = tests_failed;
+    (void)arg;
 
-    if (child_pid == 0) {
-        /* In child process */
-        grandchild_pid = fork();
-        if (grandchild_pid < 0) {
-            perror("fork");
-            exit(EXIT_FAILURE);
-        }
+    if (tree->nodes[idx].depth != 2)
+        return 0;
+
+    /* In grandchild process */
+    pid_t mypid = getpid();
+    printf("Broken chain grandchild process %d running; original expected parent is dead.\n", mypid);
+
+    long ret;
+    /* Test n == 0: returns self */
+    errno = 0;
+    ret = ancestor_pid(mypid, 0);
+    check_test(chain_check_name("Broken", 0, "self"), mypid, ret);
+
+    /* Test n == 1: returns init process */
+    errno = 0;
+    ret = ancestor_pid(mypid, 1);
+    check_test(chain_check_name("Broken", 1, "init process"), 1, ret);
+
+    /* Test n == 2: returns pid 0 */
+    errno = 0;
+    ret = ancestor_pid(mypid, 2);
+    check_test(chain_check_name("Broken", 2, "pid 0"), 0, ret);
+
+    /* Test n == 3: returns -ESRCH (no such process) */
+    errno = 0;
+    ret = ancestor_pid(mypid, 3);
+    check_test_errno(chain_check_name("Broken", 3, "no such process"), ESRCH, ret);
+
+    return tests_failed - failed_before;
+}
+
+int test_chain_broken() {
+    printf("\n[Chain Broken Test] Starting chain where intermediate parent dies...\n");
+    int failures = run_tree("main(child*(grandchild))", chain_broken_node);
+    printf("[Chain Broken Test] Completed.\n");
+    return failures;
+}
 
-        if (grandchild_pid == 0) {
-            /* In grandchild process */
-            pid_t mypid = getpid();
-            pid_t parent_pid = getppid();
-            printf("Grandchild process %d: parent = %d, expected grandparent = %d\n", 
-                   mypid, parent_pid, original_pid);
-
-            long ret;
-
-            /* Test n == 0 */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 0);
-            check_test("Alive chain: n==0 (self)", mypid, ret);
-
-            /* Test n == 1 */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 1);
-            check_test("Alive chain: n==1 (immediate parent)", parent_pid, ret);
-
-            /* Test n == 2 */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 2);
-            check_test("Alive chain: n==2 (grandparent)", original_pid, ret);
-
-            /* Test n == 3: nshould return the bash process’s PID */
-            printf("Skipping test for n==3 (bash process) because it is not guaranteed to be a static pid.\n");
-
-            /* Test n == 4: should return the login process’s PID */
-            printf("Skipping test for n==4 (login process) because it is not guaranteed to be a static pid.\n");
-
-            /* Test n == 5: should return the init process’s PID */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 5);
-            check_test("Alive chain: n==5 (init process)", 1, ret);
-
-            /* Test n == 6: should return pid 0 */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 6);
-            check_test("Alive chain: n==6 (pid 0)", 0, ret);
-
-            /* Test n == 7: should return -ESRCH (no such process) */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 7);
-            check_test_errno("Alive chain: n==7 (no such process)", ESRCH, ret);
-
-            exit(EXIT_SUCCESS);
-        } else {
-            /* In child process: wait for grandchild */
-            waitpid(grandchild_pid, &status, 0);
-            exit(EXIT_SUCCESS);
+/* Compare the syscall with the /proc oracle for every n from 0 until both
+   fail. Returns the number of disagreements. */
+int compare_with_oracle(pid_t pid) {
+    int mismatches = 0;
+    for (unsigned int n = 0; n < 64; n++) {
+        errno = 0;
+        long want = ancestor_pid_proc(pid, n);
+        int want_errno = errno;
+        errno = 0;
+        uint64_t start = report_now_ns();
+        long got = syscall(SYS_ANCESTOR_PID, pid, n);
+        report_syscall("ancestor_pid", start, got);
+        int got_errno = errno;
+
+        if (got != want || (want == -1 && got_errno != want_errno)) {
+            printf("  pid %d, n==%u: syscall %ld (errno %d), oracle %ld (errno %d)\n",
+                   pid, n, got, got_errno, want, want_errno);
+            mismatches++;
         }
-    } else {
-        /* In main process: wait for child */
-        waitpid(child_pid, &status, 0);
-        printf("[Chain Alive Test] Completed.\n");
+        if (want == -1 && got == -1)
+            break;
     }
+    return mismatches;
 }
 
-/* Test with a broken chain:
-   In this test, we create a child which forks a grandchild and then exits,
-   so that the grandchild is orphaned. To ensure the main process waits for the
-   grandchild’s tests, a pipe is used for synchronization.
+/* A PID that is (almost certainly) unused: a child we have reaped. */
+static pid_t differential_dead_pid;
+
+int differential_node(struct proctree *tree, int idx, void *arg) {
+    int failed_before = tests_failed;
+    (void)arg;
+
+    if (tree->nodes[idx].depth != 2)
+        return 0;
+    pid_t mypid = getpid();
+    check_test("Differential: lineage of grandchild", 0, compare_with_oracle(mypid));
+    check_test("Differential: lineage of PID 0 (self)", 0, compare_with_oracle(0));
+    check_test("Differential: lineage of child", 0, compare_with_oracle(getppid()));
+    check_test("Differential: lineage of main process", 0, compare_with_oracle(original_pid));
+    check_test("Differential: lineage of init", 0, compare_with_oracle(1));
+    check_test("Differential: reaped PID", 0, compare_with_oracle(differential_dead_pid));
+    check_test("Differential: negative PID", 0, compare_with_oracle(-5));
+    return tests_failed - failed_before;
+}
+
+/* Differential test:
+   main process (original_pid) -> child -> grandchild, plus a reaped child
+   whose PID no longer exists. From the grandchild, the syscall and the
+   /proc oracle must agree on the whole lineage of every process in the
+   chain and on the error cases.
 */
-void test_chain_broken() {
-    int pipefd[2];
-    pid_t child_pid, grandchild_pid;
+int test_differential_oracle() {
+    pid_t dead_pid;
     int status;
+    int failed_before = tests_failed;
 
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        exit(EXIT_FAILURE);
+    printf("\n[Differential Oracle Test] Comparing syscall with /proc oracle...\n");
+    if (use_oracle) {
+        printf("Skipping: SYS_ANCESTOR_PID is not available on this kernel.\n");
+        return 0;
     }
 
-    printf("\n[Chain Broken Test] Starting chain where intermediate parent dies...\n");
-
-    child_pid = fork();
-    if (child_pid < 0) {
+    /* A PID that is (almost certainly) unused: a child we have reaped. */
+    dead_pid = fork();
+    if (dead_pid < 0) {
         perror("fork");
         exit(EXIT_FAILURE);
     }
-
-    if (child_pid == 0) {
-        /* In child process */
-        grandchild_pid = fork();
-        if (grandchild_pid < 0) {
-            perror("fork");
-            exit(EXIT_FAILURE);
-        }
-        if (grandchild_pid == 0) {
-            /* In grandchild process */
-            close(pipefd[0]); // close read end
-            /* Sleep briefly to ensure that the immediate parent has exited */
-            sleep(3);
-            pid_t mypid = getpid();
-            printf("Broken chain grandchild process %d running; original expected parent is dead.\n", mypid);
-
-            long ret;
-            /* Test n == 0: returns self */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 0);
-            check_test("Broken chain: n==0 (self)", mypid, ret);
-
-            /* Test n == 1: returns init process */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 1);
-            check_test("Broken chain: n==1 (init process)", 1, ret);
-
-            /* Test n == 2: returns pid 0 */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 2);
-            check_test("Broken chain: n==2 (pid 0)", 0, ret);
-
-            /* Test n == 3: returns -ESRCH (no such process) */
-            errno = 0;
-            ret = syscall(SYS_ANCESTOR_PID, mypid, 3);
-            check_test_errno("Broken chain: n==3 (no such process)", ESRCH, ret);
-
-            /* Signal completion via the pipe */
-            if (write(pipefd[1], "done", 4) == -1) {
-                perror("write");
-            }
-            close(pipefd[1]);
-            exit(EXIT_SUCCESS);
-        } else {
-            /* In child process: exit immediately so that the parent dies */
-            exit(EXIT_SUCCESS);
-        }
-    } else {
-        /* In main process */
-        close(pipefd[1]); // close write end
-        /* Wait for the broken chain grandchild to signal completion */
-        char buf[10];
-        if (read(pipefd[0], buf, sizeof(buf)) < 0) {
-            perror("read");
-        }
-        close(pipefd[0]);
-        waitpid(child_pid, &status, 0);
-        printf("[Chain Broken Test] Completed.\n");
-    }
+    if (dead_pid == 0)
+        _exit(EXIT_SUCCESS);
+    waitpid(dead_pid, &status, 0);
+
+    differential_dead_pid = dead_pid;
+    run_tree("main(child(grandchild))", differential_node);
+    printf("[Differential Oracle Test] Completed.\n");
+    return tests_failed - failed_before;
 }
 
-int main(void) {
+/* Worker setup: each test's chain hangs off its own worker process. */
+static void setup_worker(void) {
     original_pid = getpid();
-    printf("Starting sys_ancestor_pid tests in process %d\n", original_pid);
+}
 
-    basic_tests();
-    test_chain_alive();
-    test_chain_broken();
+static const struct runner_test tests[] = {
+    { "basic_tests", basic_tests },
+    { "test_chain_alive", test_chain_alive },
+    { "test_chain_broken", test_chain_broken },
+    { "test_differential_oracle", test_differential_oracle },
+};
+
+int main(int argc, char **argv) {
+    /* No subreaper or PID namespace here: test_chain_broken relies on the
+       orphaned grandchild being reparented to init. */
+    struct runner_opts opts = { .setup = setup_worker, .on_start = report_test_begin,
+                                .on_finish = report_test_end };
+    int serial = runner_parse_args(argc, argv, &opts);
+    report_open("task1_tests");
+
+    printf("Starting sys_ancestor_pid tests in process %d\n", getpid());
+
+    use_oracle = syscall(SYS_ANCESTOR_PID, 0, 0) != getpid();
+    if (use_oracle)
+        printf("SYS_ANCESTOR_PID not available: testing the /proc reference implementation.\n");
+
+    if (serial) {
+        tests_failed = runner_run_serial(tests, sizeof(tests) / sizeof(tests[0]), &opts);
+    } else {
+        extra_depth = 1;
+        tests_failed = runner_run(tests, sizeof(tests) / sizeof(tests[0]), &opts);
+    }
+    report_close();
 
     if (tests_failed == 0) {
         printf("\nAll tests PASSED.\n");
@@ -0,0 +1,222 @@
+/* propagate_nice_bench.c
+
+   Latency benchmark for sys_propagate_nice (ID 464) on wide and deep
+   process trees.
+
+   Each tree shape is a comma-separated list of per-level fan-outs: "1000"
+   is a root with 1000 children, "1000,1,1" gives each of those a chain of
+   two more descendants (3000 in total), "10,10,10" is a full 10-ary tree
+   of depth 3. For every shape a fresh root process builds the tree with
+   ../common/proctree.h (clone(CLONE_VM) nodes, so building 10k processes
+   takes a fraction of a second), waits until every descendant is in
+   place, and then times `repeats` calls of
+   syscall(SYS_PROPAGATE_NICE, increment).
+
+   The increment defaults to 2^depth so that the halved increment still
+   reaches the deepest level. Between calls the whole tree is reset to
+   nice 0 with setpriority(PRIO_PGRP), which needs CAP_SYS_NICE; without
+   it each shape is timed only once.
+
+   The syscall walks the tree under the tasklist lock, so its latency is
+   also roughly how long it holds that lock. The report gives min/p50/max
+   per shape and the cost per descendant touched, i.e. per descendant at
+   a level the halved increment still reaches.
+
+   Compile with:
+       gcc -O2 -Wall -o propagate_nice_bench propagate_nice_bench.c
+
+   Usage:
+       ./propagate_nice_bench [-r repeats] [-n increment] [shape ...]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <string.h>
+#include "../common/bench.h"
+#include "../common/proctree.h"
+
+#ifndef SYS_PROPAGATE_NICE
+#define SYS_PROPAGATE_NICE 464
+#endif
+
+#define HEADROOM 64
+
+static const char *default_shapes[] = {
+    "0", "10", "100", "1000", "10000", "1000,1,1", "10,10,10", "100,100", "1,1,1,1,1,1,1,1",
+};
+
+static int repeats = 20;
+static int increment = 0;       /* 0: 2^depth, capped at 19 */
+
+struct shape {
+    const char *spec;
+    int levels;
+    int fanout[PROCTREE_MAX_LEVELS];
+    long nodes;                 /* descendants of the root */
+};
+
+static int parse_shape(const char *spec, struct shape *s) {
+    s->spec = spec;
+    s->levels = proctree_parse_shape(spec, s->fanout, &s->nodes);
+    return s->levels < 0 ? -1 : 0;
+}
+
+static long read_long_file(const char *path) {
+    FILE *fp = fopen(path, "r");
+    long val = -1;
+    if (!fp)
+        return -1;
+    if (fscanf(fp, "%ld", &val) != 1)
+        val = -1;
+    fclose(fp);
+    return val;
+}
+
+/* Rough upper bound on the number of processes we may still create. */
+static long process_budget(void) {
+    long limit = read_long_file("/proc/sys/kernel/pid_max");
+    long threads_max = read_long_file("/proc/sys/kernel/threads-max");
+    struct rlimit rl;
+
+    if (threads_max > 0 && (limit < 0 || threads_max < limit))
+        limit = threads_max;
+    /* RLIMIT_NPROC is not enforced for root. */
+    if (getuid() != 0 && getrlimit(RLIMIT_NPROC, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+        (limit < 0 || (long)rl.rlim_cur < limit))
+        limit = rl.rlim_cur;
+    return limit < 0 ? -1 : limit - HEADROOM;
+}
+
+/* Runs in a fresh process that becomes the root of the tree. */
+static int run_shape(const struct shape *s, int inc) {
+    uint64_t samples[repeats];
+    int taken = 0, status = EXIT_SUCCESS;
+
+    setpgid(0, 0);
+    setpriority(PRIO_PROCESS, 0, 0);
+
+    struct proctree tree;
+    char *spec = proctree_fanout_spec(s->fanout, s->levels);
+    if (!spec || proctree_create(&tree, spec) == -1) {
+        perror("proctree_create");
+        free(spec);
+        return EXIT_FAILURE;
+    }
+    free(spec);
+    tree.mode = PROCTREE_CLONE_VM;
+
+    uint64_t start = bench_now_ns();
+    if (proctree_spawn(&tree, NULL, NULL, NULL) == -1) {
+        fprintf(stderr, "%s: the tree did not come up\n", s->spec);
+        proctree_destroy(&tree);
+        return EXIT_FAILURE;
+    }
+    double build_secs = (bench_now_ns() - start) / 1e9;
+
+    for (int r = 0; r < repeats; r++) {
+        if (r > 0 && setpriority(PRIO_PGRP, 0, 0) == -1) {
+            if (r == 1)
+                fprintf(stderr, "%s: cannot reset nice values (%s), timing one call only\n",
+                        s->spec, strerror(errno));
+            break;
+        }
+        uint64_t t0 = bench_now_ns();
+        long ret = syscall(SYS_PROPAGATE_NICE, inc);
+        uint64_t t1 = bench_now_ns();
+        if (ret == -1) {
+            fprintf(stderr, "%s: propagate_nice(%d) failed: %s\n", s->spec, inc, strerror(errno));
+            status = EXIT_FAILURE;
+            goto out;
+        }
+        samples[taken++] = t1 - t0;
+    }
+
+    /* Descendants at levels the halved increment still reaches. */
+    long touched = 0, width = 1;
+    for (int l = 0; l < s->levels && (inc >> (l + 1)) > 0; l++) {
+        width *= s->fanout[l];
+        touched += width;
+    }
+
+    struct bench_summary sum;
+    bench_summarize(samples, taken, &sum);
+    printf("%-18s %8ld %8ld %4d %12llu %12llu %12llu %10.1f %8.1f\n", s->spec, s->nodes, touched,
+           taken, (unsigned long long)sum.min, (unsigned long long)sum.p50,
+           (unsigned long long)sum.max, touched ? (double)sum.p50 / touched : 0.0,
+           build_secs);
+    bench_metric(sum.p50, "propagate_nice.%s.p50_ns", s->spec);
+
+out:
+    fflush(stdout);
+    proctree_release(&tree);
+    proctree_finish(&tree);
+    proctree_destroy(&tree);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "r:n:")) != -1) {
+        switch (opt) {
+        case 'r': repeats = atoi(optarg); break;
+        case 'n': increment = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-r repeats] [-n increment] [shape ...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (repeats < 1 || increment < 0) {
+        fprintf(stderr, "repeats must be >= 1 and increment >= 0\n");
+        return EXIT_FAILURE;
+    }
+
+    const char **specs = (const char **)argv + optind;
+    int nspecs = argc - optind;
+    if (nspecs == 0) {
+        specs = default_shapes;
+        nspecs = sizeof(default_shapes) / sizeof(default_shapes[0]);
+    }
+
+    long budget = process_budget();
+    int failures = 0;
+
+    printf("%-18s %8s %8s %4s %12s %12s %12s %10s %8s\n", "shape", "nodes", "touched", "n",
+           "min(ns)", "p50(ns)", "max(ns)", "ns/node", "build(s)");
+    for (int i = 0; i < nspecs; i++) {
+        struct shape s;
+        if (parse_shape(specs[i], &s) == -1) {
+            fprintf(stderr, "bad shape \"%s\": expected fan-outs like 1000,1,1\n", specs[i]);
+            failures++;
+            continue;
+        }
+        if (budget >= 0 && s.nodes > budget) {
+            fprintf(stderr, "%s: %ld processes exceed the limit of %ld, skipped\n",
+                    s.spec, s.nodes, budget);
+            continue;
+        }
+        int inc = increment;
+        if (inc == 0)
+            inc = s.levels < 5 ? 1 << s.levels : 19;
+
+        fflush(stdout);
+        pid_t root = fork();
+        if (root < 0) {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (root == 0)
+            _exit(run_shape(&s, inc));
+        int status;
+        waitpid(root, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failures++;
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,452 @@
+/* propagate_nice_fuzz.c
+
+   Property-based fuzzer for sys_propagate_nice (ID 464).
+
+   Every case is a random process tree: a random shape (from bushy to
+   chain-like), random starting nice values (biased towards the clamp at
+   19), random dead processes, and a random increment (mostly valid, odd
+   and even, sometimes 0 or negative). A fresh process becomes the root of
+   the case, builds the tree, waits on a latch until every live process is
+   in place and every dead one is a zombie, and calls propagate_nice(inc).
+   Each live process then reports its own nice value through a shared
+   results table (../common/results.h).
+
+   The result is checked against a reference model computed from the case
+   description alone, independently of /proc:
+     - inc <= 0 fails with EINVAL and changes nothing;
+     - otherwise the root gets +inc, a live process at depth d gets
+       +(inc >> d), all clamped to [-20, 19];
+     - dead processes, and the children they orphaned (reparented away
+       from the tree), are not touched.
+
+   A failing case is shrunk (drop subtrees, revive dead processes, flatten
+   nice values, lower the increment) while it keeps failing, and the
+   minimal reproducer is printed along with the seed that generated it;
+   -r replays a single case from its seed, given the same -N and the same
+   privilege (the printed replay command says which).
+
+   Cases run in parallel, one worker process per CPU by default.
+
+   Without CAP_SYS_NICE nice values can only go up, so children then start
+   at or above their parent's nice value.
+
+   Compile with:
+       gcc -O2 -Wall -o propagate_nice_fuzz propagate_nice_fuzz.c
+
+   Usage:
+       ./propagate_nice_fuzz [-j jobs] [-n cases] [-N max_nodes] [-s seed] [-r case_seed]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "../common/latch.h"
+#include "../common/results.h"
+
+#ifndef SYS_PROPAGATE_NICE
+#define SYS_PROPAGATE_NICE 464
+#endif
+
+#define MAX_NODES 64
+
+static int jobs = 0;
+static long cases = 200;
+static int max_nodes = 24;
+static unsigned long long seed = 0;
+static int privileged = 0;
+
+/* Node 0 is the root, which calls propagate_nice; parent[i] < i. */
+struct fcase {
+    unsigned long long seed;
+    int n;
+    int inc;
+    int parent[MAX_NODES];
+    int dead[MAX_NODES];
+    int nice[MAX_NODES];
+};
+
+/* Per-worker shared state, reused by every case the worker runs. */
+static struct latch *ready;     /* live processes in place */
+static struct results *results; /* nice value of node i after the call */
+
+/* ---- case generation ---- */
+
+static unsigned long long rng_next(unsigned long long *s) {
+    /* xorshift64* */
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ULL;
+}
+
+/*
+ * splitmix64, to spread a case seed over the xorshift state. It is a
+ * bijection, so distinct seeds give distinct cases; the one seed it maps to
+ * 0, which xorshift cannot start from, is moved to a fixed nonzero state.
+ */
+static unsigned long long rng_seed(unsigned long long x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x ? x : 0x9e3779b97f4a7c15ULL;
+}
+
+static int rng_range(unsigned long long *s, int lo, int hi) {
+    return lo + (int)(rng_next(s) % (unsigned long long)(hi - lo + 1));
+}
+
+static int clamp_nice(int v) {
+    return v > 19 ? 19 : v < -20 ? -20 : v;
+}
+
+static void generate(struct fcase *c, unsigned long long case_seed) {
+    unsigned long long s = rng_seed(case_seed);
+    memset(c, 0, sizeof(*c));
+    c->seed = case_seed;
+    c->n = rng_range(&s, 1, max_nodes);
+    int chain_bias = rng_range(&s, 0, 3);
+
+    c->parent[0] = -1;
+    c->nice[0] = privileged ? rng_range(&s, -20, 19) : rng_range(&s, 0, 19);
+    for (int i = 1; i < c->n; i++) {
+        c->parent[i] = rng_range(&s, 0, 3) < chain_bias ? i - 1 : rng_range(&s, 0, i - 1);
+        c->dead[i] = rng_range(&s, 0, 5) == 0;
+        if (privileged)
+            c->nice[i] = rng_range(&s, 0, 3) == 0 ? rng_range(&s, 15, 19) : rng_range(&s, -20, 19);
+        else
+            c->nice[i] = clamp_nice(c->nice[c->parent[i]] + rng_range(&s, 0, 4));
+    }
+    switch (rng_range(&s, 0, 9)) {
+    case 0: c->inc = rng_range(&s, -8, 0); break;
+    case 1: c->inc = rng_range(&s, 32, 100); break;
+    default: c->inc = rng_range(&s, 1, 31); break;
+    }
+}
+
+/* ---- reference model ---- */
+
+static int depth_of(const struct fcase *c, int i) {
+    int d = 0;
+    while (c->parent[i] >= 0) {
+        i = c->parent[i];
+        d++;
+    }
+    return d;
+}
+
+/* Does i still hang off the root, i.e. is nothing on its path dead? */
+static int in_tree(const struct fcase *c, int i) {
+    for (; i >= 0; i = c->parent[i])
+        if (c->dead[i])
+            return 0;
+    return 1;
+}
+
+static int expected_nice(const struct fcase *c, int i) {
+    if (c->inc <= 0 || !in_tree(c, i))
+        return c->nice[i];
+    int d = depth_of(c, i);
+    return clamp_nice(c->nice[i] + (d < 31 ? c->inc >> d : 0));
+}
+
+/* ---- running a case ---- */
+
+static void wait_dead(pid_t pid) {
+    siginfo_t info;
+    waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+}
+
+/* Body of node i: take its nice value, fork its children, then either die
+   at once or park on the latch until the root has called propagate_nice
+   and report the resulting nice value. */
+static int run_node(const struct fcase *c, int i) {
+    if (i > 0 && setpriority(PRIO_PROCESS, 0, c->nice[i]) == -1)
+        perror("setpriority");
+    for (int j = i + 1; j < c->n; j++) {
+        if (c->parent[j] != i)
+            continue;
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            continue;
+        }
+        if (pid == 0)
+            _exit(run_node(c, j));
+        if (c->dead[j])
+            wait_dead(pid);
+    }
+    /* The root goes on to call propagate_nice; dead nodes just exit. */
+    if (i == 0 || c->dead[i])
+        return 0;
+    latch_arrive(ready);
+    latch_wait_go(ready);
+    results_report(results, i, getpid(), getpriority(PRIO_PROCESS, 0), 0);
+    while (wait(NULL) > 0)
+        ;
+    return 0;
+}
+
+static int count_live(const struct fcase *c) {
+    int live = 0;
+    for (int i = 1; i < c->n; i++)
+        live += !c->dead[i];
+    return live;
+}
+
+/* Runs in a fresh process that is node 0. Prints the mismatches if
+   `verbose` and returns their number (0 = the case passed). */
+static int run_case_root(const struct fcase *c, int verbose) {
+    int live = count_live(c), failures = 0;
+    int observed[MAX_NODES];
+
+    if (setpriority(PRIO_PROCESS, 0, c->nice[0]) == -1)
+        perror("setpriority (root)");
+    latch_reset(ready);
+    results_reset(results);
+    run_node(c, 0);
+
+    if (latch_wait_ready(ready, live) == -1) {
+        if (verbose)
+            printf("  tree did not come up (%d of %d)\n", atomic_load(&ready->ready), live);
+        latch_release(ready);
+        while (wait(NULL) > 0)
+            ;
+        return 1;
+    }
+
+    errno = 0;
+    long ret = syscall(SYS_PROPAGATE_NICE, c->inc);
+    int err = errno;
+    observed[0] = getpriority(PRIO_PROCESS, 0);
+    latch_release(ready);
+
+    /* Orphans are not our children, so the table is also how we know that
+       every live process is off the latch before it is reset for the next
+       case. */
+    results_wait(results, live);
+    for (int i = 1; i < c->n; i++) {
+        const struct result_slot *slot = results_get(results, i);
+        observed[i] = c->dead[i] ? c->nice[i] : slot ? slot->value : PRIO_MIN - 1;
+    }
+
+    if (c->inc <= 0 ? (ret != -1 || err != EINVAL) : ret != 0) {
+        if (verbose)
+            printf("  propagate_nice(%d) returned %ld (errno %d), expected %s\n", c->inc, ret, err,
+                   c->inc <= 0 ? "-1/EINVAL" : "0");
+        failures++;
+    }
+    for (int i = 0; i < c->n; i++) {
+        if (c->dead[i] || observed[i] == expected_nice(c, i))
+            continue;
+        if (verbose)
+            printf("  node %d (depth %d%s): nice %d -> %d, expected %d\n", i, depth_of(c, i),
+                   in_tree(c, i) ? "" : ", orphaned", c->nice[i], observed[i], expected_nice(c, i));
+        failures++;
+    }
+
+    while (wait(NULL) > 0)
+        ;
+    return failures;
+}
+
+/* Run c in a fresh root process; returns the number of mismatches. */
+static int run_case(const struct fcase *c, int verbose) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        int failures = run_case_root(c, verbose);
+        fflush(stdout);
+        _exit(failures > 255 ? 255 : failures);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+/* ---- shrinking ---- */
+
+/* Remove node k and its whole subtree, renumbering the rest. */
+static void drop_subtree(struct fcase *c, int k) {
+    int keep[MAX_NODES], map[MAX_NODES], n = 0;
+    for (int i = 0; i < c->n; i++) {
+        keep[i] = i != k && !(c->parent[i] >= 0 && !keep[c->parent[i]]);
+        map[i] = keep[i] ? n++ : -1;
+    }
+    struct fcase out = *c;
+    out.n = n;
+    for (int i = 0; i < c->n; i++) {
+        if (!keep[i])
+            continue;
+        out.parent[map[i]] = c->parent[i] < 0 ? -1 : map[c->parent[i]];
+        out.dead[map[i]] = c->dead[i];
+        out.nice[map[i]] = c->nice[i];
+    }
+    *c = out;
+}
+
+static int try_candidate(struct fcase *c, const struct fcase *cand) {
+    if (run_case(cand, 0) == 0)
+        return 0;
+    *c = *cand;
+    return 1;
+}
+
+static void shrink(struct fcase *c) {
+    int progress = 1;
+    while (progress) {
+        progress = 0;
+        for (int k = c->n - 1; k >= 1; k--) {
+            struct fcase cand = *c;
+            drop_subtree(&cand, k);
+            progress |= try_candidate(c, &cand);
+        }
+        for (int k = 1; k < c->n; k++) {
+            if (!c->dead[k])
+                continue;
+            struct fcase cand = *c;
+            cand.dead[k] = 0;
+            progress |= try_candidate(c, &cand);
+        }
+        for (int k = 0; k < c->n; k++) {
+            int base = privileged || k == 0 ? 0 : c->nice[c->parent[k]];
+            if (c->nice[k] == base)
+                continue;
+            struct fcase cand = *c;
+            cand.nice[k] = base;
+            progress |= try_candidate(c, &cand);
+        }
+        if (c->inc > 1 || c->inc < 0) {
+            struct fcase cand = *c;
+            cand.inc = c->inc > 1 ? c->inc / 2 : 0;
+            if (try_candidate(c, &cand)) {
+                progress = 1;
+            } else if (c->inc > 1) {
+                cand.inc = c->inc - 1;
+                progress |= try_candidate(c, &cand);
+            }
+        }
+    }
+}
+
+static void print_case(const struct fcase *c) {
+    printf("case seed %llu: propagate_nice(%d) on %d process(es)\n", c->seed, c->inc, c->n);
+    for (int i = 0; i < c->n; i++) {
+        printf("  node %d: parent %d, depth %d, nice %d%s -> expected %d\n", i, c->parent[i],
+               depth_of(c, i), c->nice[i], c->dead[i] ? ", dead" : "", expected_nice(c, i));
+    }
+}
+
+/* ---- workers ---- */
+
+static int setup_shared(void) {
+    ready = latch_create();
+    results = results_create(MAX_NODES);
+    return !ready || !results ? -1 : 0;
+}
+
+static int report_failure(struct fcase *c) {
+    struct fcase original = *c;
+    shrink(c);
+    printf("\nFAIL: case seed %llu (%d process(es), inc %d) shrunk to:\n",
+           original.seed, original.n, original.inc);
+    print_case(c);
+    run_case(c, 1);
+    /* The case also depends on -N and on whether nice may go down. */
+    printf("Replay with: propagate_nice_fuzz -N %d -r %llu (%s)\n", max_nodes, original.seed,
+           privileged ? "with CAP_SYS_NICE, e.g. as root" : "without CAP_SYS_NICE");
+    fflush(stdout);
+    return 1;
+}
+
+static int run_worker(int worker) {
+    if (setup_shared() == -1) {
+        perror("latch_create/results_create");
+        return 1;
+    }
+    for (long k = 0; k < cases; k++) {
+        struct fcase c;
+        generate(&c, seed + (unsigned long long)worker * 1000003ULL + (unsigned long long)k * 7919ULL);
+        if (run_case(&c, 0) != 0)
+            return report_failure(&c);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned long long replay = 0;
+    int replaying = 0;
+    int opt;
+
+    seed = (unsigned long long)time(NULL);
+    while ((opt = getopt(argc, argv, "j:n:N:s:r:")) != -1) {
+        switch (opt) {
+        case 'j': jobs = atoi(optarg); break;
+        case 'n': cases = atol(optarg); break;
+        case 'N': max_nodes = atoi(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 10); break;
+        case 'r': replay = strtoull(optarg, NULL, 10); replaying = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-j jobs] [-n cases] [-N max_nodes] [-s seed] [-r case_seed]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_nodes < 1 || max_nodes > MAX_NODES) {
+        fprintf(stderr, "max_nodes must be between 1 and %d\n", MAX_NODES);
+        return EXIT_FAILURE;
+    }
+    if (jobs <= 0)
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs <= 0)
+        jobs = 1;
+
+    /* Lowering a nice value needs CAP_SYS_NICE; probe for it. */
+    privileged = setpriority(PRIO_PROCESS, 0, -1) == 0;
+    setpriority(PRIO_PROCESS, 0, 0);
+
+    if (replaying) {
+        struct fcase c;
+        if (setup_shared() == -1) {
+            perror("latch_create/results_create");
+            return EXIT_FAILURE;
+        }
+        generate(&c, replay);
+        print_case(&c);
+        int failures = run_case(&c, 1);
+        printf("%s\n", failures ? "FAIL" : "PASS");
+        return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    printf("Fuzzing propagate_nice: %d worker(s) x %ld case(s), up to %d processes, seed %llu%s\n",
+           jobs, cases, max_nodes, seed, privileged ? "" : " (unprivileged: nice only goes up)");
+    fflush(stdout);
+
+    for (int w = 0; w < jobs; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (pid == 0)
+            _exit(run_worker(w));
+    }
+    int failed = 0, status;
+    while (wait(&status) > 0)
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+
+    printf("%s: %d of %d worker(s) found a failing case\n", failed ? "FAIL" : "PASS", failed, jobs);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+/* propagate_nice_model.h
+
+   Userspace model of sys_propagate_nice (ID 464), driven by a snapshot of
+   the live process tree.
+
+   propagate_nice(inc) raises the caller's nice value by inc and every live
+   descendant's by inc halved once per level: children get inc/2,
+   grandchildren inc/4, and so on. Nice values are clamped to [-20, 19],
+   propagation stops below the first level whose increment rounds down to
+   zero, and dead (zombie) children are skipped together with the subtree
+   that hangs off them.
+
+   Typical use, while every descendant is parked on a latch:
+
+       struct pn_snapshot snap;
+       pn_snapshot_take(&snap, 0);
+       pn_model_apply(&snap, inc);
+       propagate_nice(inc);
+       failures = pn_verify(&snap);
+       pn_snapshot_free(&snap);
+
+   Children are found through /proc/<pid>/task/<tid>/children when the
+   kernel provides it (CONFIG_PROC_CHILDREN), otherwise by scanning the
+   PPid of every process in /proc.
+
+   All PIDs are as seen in /proc, and pn_verify() reads nice values back
+   from /proc as well, so the model also works from inside a new PID
+   namespace whose /proc is the parent's (as under ../common/runner.h).
+   Pass root == 0 to snapshot the caller.
+*/
+
+#ifndef PROPAGATE_NICE_MODEL_H
+#define PROPAGATE_NICE_MODEL_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PN_NICE_MIN -20
+#define PN_NICE_MAX 19
+
+struct pn_node {
+    pid_t pid;
+    int parent;             /* index of the parent node, -1 for the root */
+    int depth;              /* 0 for the root */
+    int nice;               /* nice value when the snapshot was taken */
+    int expected;           /* nice value predicted by pn_model_apply() */
+};
+
+/* Nodes in breadth-first order; nodes[0] is the root. */
+struct pn_snapshot {
+    struct pn_node *nodes;
+    size_t n, cap;
+};
+
+/* State, parent and nice value of pid from /proc/<pid>/stat.
+   Returns 0, or -1 if the process does not exist. */
+static inline int pn_read_stat(pid_t pid, char *state, pid_t *ppid, int *nice)
+{
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+
+    /* comm may contain spaces and parens: parse from the last ')'. Fields
+       after it: state ppid pgrp session tty_nr tpgid flags minflt cminflt
+       majflt cmajflt utime stime cutime cstime priority nice */
+    char *p = strrchr(buf, ')');
+    if (!p || sscanf(p + 1, " %c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %d",
+                     state, ppid, nice) != 3)
+        return -1;
+    return 0;
+}
+
+static inline int pn_add_node(struct pn_snapshot *s, pid_t pid, int parent, int depth)
+{
+    char state;
+    pid_t ppid;
+    int nice;
+
+    /* Skip processes that exited since they were listed, and zombies. */
+    if (pn_read_stat(pid, &state, &ppid, &nice) == -1 || state == 'Z' || state == 'X')
+        return 0;
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 64;
+        struct pn_node *nodes = realloc(s->nodes, cap * sizeof(*nodes));
+        if (!nodes)
+            return -1;
+        s->nodes = nodes;
+        s->cap = cap;
+    }
+    s->nodes[s->n++] = (struct pn_node){ pid, parent, depth, nice, nice };
+    return 0;
+}
+
+/* Append the children of nodes[idx] listed in /proc/<pid>/task/<tid>/children.
+   Returns 0 or -1. */
+static inline int pn_add_children_proc(struct pn_snapshot *s, size_t idx)
+{
+    char path[64];
+    pid_t pid = s->nodes[idx].pid;
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR *dir = opendir(path);
+    if (!dir)
+        return 0;
+
+    struct dirent *de;
+    int ret = 0;
+    while (ret == 0 && (de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+        char cpath[300];
+        snprintf(cpath, sizeof(cpath), "/proc/%d/task/%s/children", pid, de->d_name);
+        FILE *fp = fopen(cpath, "r");
+        if (!fp)
+            continue;
+        int child;
+        while (ret == 0 && fscanf(fp, "%d", &child) == 1)
+            ret = pn_add_node(s, child, (int)idx, s->nodes[idx].depth + 1);
+        fclose(fp);
+    }
+    closedir(dir);
+    return ret;
+}
+
+/* Fallback without children files: one pass over /proc collecting every
+   (pid, ppid) pair, then a breadth-first walk from the root. */
+static inline int pn_add_descendants_scan(struct pn_snapshot *s)
+{
+    DIR *dir = opendir("/proc");
+    if (!dir)
+        return -1;
+    struct { pid_t pid, ppid; } *procs = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        pid_t pid = atoi(de->d_name), ppid;
+        char state;
+        int nice;
+        if (pid <= 0 || pn_read_stat(pid, &state, &ppid, &nice) == -1)
+            continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            void *p = realloc(procs, cap * sizeof(*procs));
+            if (!p) {
+                free(procs);
+                closedir(dir);
+                return -1;
+            }
+            procs = p;
+        }
+        procs[n].pid = pid;
+        procs[n].ppid = ppid;
+        n++;
+    }
+    closedir(dir);
+
+    int ret = 0;
+    for (size_t idx = 0; ret == 0 && idx < s->n; idx++)
+        for (size_t i = 0; ret == 0 && i < n; i++)
+            if (procs[i].ppid == s->nodes[idx].pid)
+                ret = pn_add_node(s, procs[i].pid, (int)idx, s->nodes[idx].depth + 1);
+    free(procs);
+    return ret;
+}
+
+/* Snapshot root (0 for the caller) and all its live descendants.
+   Returns 0 or -1. */
+static inline int pn_snapshot_take(struct pn_snapshot *s, pid_t root)
+{
+    memset(s, 0, sizeof(*s));
+    if (root == 0) {
+        char self[32];
+        ssize_t len = readlink("/proc/self", self, sizeof(self) - 1);
+        if (len <= 0)
+            return -1;
+        self[len] = '\0';
+        root = atoi(self);
+    }
+    if (pn_add_node(s, root, -1, 0) == -1 || s->n == 0)
+        return -1;
+    if (access("/proc/thread-self/children", F_OK) == -1)
+        return pn_add_descendants_scan(s);
+    for (size_t idx = 0; idx < s->n; idx++)
+        if (pn_add_children_proc(s, idx) == -1)
+            return -1;
+    return 0;
+}
+
+static inline void pn_snapshot_free(struct pn_snapshot *s)
+{
+    free(s->nodes);
+    s->nodes = NULL;
+    s->n = s->cap = 0;
+}
+
+/* Fill in nodes[].expected for propagate_nice(inc) called by the root. */
+static inline void pn_model_apply(struct pn_snapshot *s, int inc)
+{
+    for (size_t i = 0; i < s->n; i++) {
+        struct pn_node *node = &s->nodes[i];
+        int level_inc = node->depth < 31 ? inc >> node->depth : 0;
+        int v = node->nice + level_inc;
+        node->expected = v > PN_NICE_MAX ? PN_NICE_MAX : v < PN_NICE_MIN ? PN_NICE_MIN : v;
+    }
+}
+
+/* Compare every node's current nice value with the model. Prints one FAIL
+   line per mismatch and returns the number of mismatches. */
+static inline int pn_verify(const struct pn_snapshot *s)
+{
+    int failures = 0;
+    for (size_t i = 0; i < s->n; i++) {
+        const struct pn_node *node = &s->nodes[i];
+        char state;
+        pid_t ppid;
+        int nice;
+        if (pn_read_stat(node->pid, &state, &ppid, &nice) == -1 || state == 'Z') {
+            printf("FAIL: PID %d (depth %d) vanished before verification\n",
+                   node->pid, node->depth);
+            failures++;
+        } else if (nice != node->expected) {
+            printf("FAIL: PID %d (depth %d) niceness = %d, expected %d (was %d)\n",
+                   node->pid, node->depth, nice, node->expected, node->nice);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+#endif /* PROPAGATE_NICE_MODEL_H */
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -5,203 +6,244 @@
 #include <sys/wait.h>
 #include <sys/resource.h>
 #include <errno.h>
+#include "../common/proctree.h"
+#include "../common/report.h"
+#include "../common/results.h"
+#include "../common/runner.h"
+#include "propagate_nice_model.h"
 #define SYS_PROPAGATE_NICE 464
-/* 
+/*
+
+ * Tree-node callback (../common/proctree.h): report the node's niceness
 
- * Wrapper for the propagate_nice system call.
+ * once the test has called propagate_nice.
 
  */
 
-int propagate_nice(int increment) {
+int report_nice_node(struct proctree *tree, int idx, void *arg) {
+
+    (void)tree; (void)idx; (void)arg;
 
-    return syscall(SYS_PROPAGATE_NICE, increment);
+    return getpriority(PRIO_PROCESS, 0);
 
 }
-/* -----------------------------------------------------------------
 
-   Test Case 1: Basic Functionality – Positive Increment with Live Children
+/*
 
-   Description:
+ * Niceness reported by the tree node called `name`, or -100 if it never
 
-     - Parent’s niceness increases by 4.
+ * reported.
 
-     - Child receives floor(4/2)=2 increment.
+ */
 
-     - Grandchild receives floor(2/2)=1 increment.
+int tree_nice(struct proctree *tree, const char *name) {
 
-   Expected:
+    const struct result_slot *slot = results_get(tree->results, proctree_find(tree, name));
 
-     - Parent: 0 + 4 = 4.
+    if (!slot) {
 
-     - Child: 0 + 2 = 2.
+        printf("FAIL: %s never reported its niceness\n", name);
 
-     - Grandchild: 0 + 1 = 1.
+        return -100;
 
-------------------------------------------------------------------*/
+    }
 
-int test_positive_increment_live_children() {
+    return slot->value;
 
-    printf("\nTest 1: Positive Increment with Live Children\n");
+}
 
-    int status = 0;
+/*
 
-    /* Set parent's niceness to 0 */
+ * Build the tree described by `spec` below the calling process, with every
 
-    if (setpriority(PRIO_PROCESS, 0, 0) == -1) {
+ * live node parked until proctree_release(). Large trees use CLONE_VM
 
-        perror("setpriority (parent)");
+ * nodes (see proctree.h), which is safe here because the callbacks only
 
-        return 1;
+ * make system calls and errno is read before proctree_release().
 
-    }
+ * Returns 0 or -1.
 
-    int pipe_child[2], pipe_grandchild[2];
+ */
+
+int spawn_tree(struct proctree *tree, const char *spec, proctree_fn setup, int mode) {
 
-    if (pipe(pipe_child) == -1) { perror("pipe_child"); return 1; }
+    if (proctree_create(tree, spec) == -1) {
 
-    if (pipe(pipe_grandchild) == -1) { perror("pipe_grandchild"); return 1; }
+        perror("proctree_create");
 
+        return -1;
 
+    }
 
-    pid_t child = fork();
+    tree->mode = mode;
 
-    if (child == -1) {
+    if (proctree_spawn(tree, setup, report_nice_node, NULL) == -1) {
 
-        perror("fork (child)");
+        proctree_destroy(tree);
 
-        return 1;
+        return -1;
 
     }
 
-    if (child == 0) {
+    return 0;
 
-        /* Child process: fork a grandchild */
+}
 
-        pid_t grandchild = fork();
+/* 
 
-        if (grandchild == -1) { perror("fork (grandchild)"); exit(1); }
+ * Wrapper for the propagate_nice system call, timed for the structured report.
 
-        if (grandchild == 0) {
+ */
 
-            /* Grandchild process: wait to let propagation occur */
+int propagate_nice(int increment) {
 
-            sleep(2);
+    uint64_t start = report_now_ns();
 
-            int nic = getpriority(PRIO_PROCESS, 0);
+    long ret = syscall(SYS_PROPAGATE_NICE, increment);
 
-            write(pipe_grandchild[1], &nic, sizeof(nic));
+    report_syscall("propagate_nice", start, ret);
 
-            exit(0);
+    return ret;
 
-        } else {
+}
+/*
 
-            /* Child process: wait a bit, then report its niceness */
+ * Check helpers: print PASS or FAIL and record the check in the structured
 
-            sleep(2);
+ * report (../common/report.h). They return 0 on PASS and 1 on FAIL.
 
-            int nic = getpriority(PRIO_PROCESS, 0);
+ */
 
-            write(pipe_child[1], &nic, sizeof(nic));
+int check_nice(const char *who, int actual, int expected) {
 
-            wait(NULL); // wait for grandchild
+    char description[64];
 
-            exit(0);
+    snprintf(description, sizeof(description), "%s niceness", who);
 
-        }
+    if (actual != expected) {
 
-    } else {
+        printf("FAIL: %s = %d, expected %d\n", description, actual, expected);
 
-        /* Parent process: let children get ready then call propagate_nice(4) */
+        report_check(description, 0, "niceness %d, expected %d", actual, expected);
 
-        sleep(1);
+        return 1;
 
-        int ret = propagate_nice(4);
+    }
 
-        if (ret == -1) {
+    printf("PASS: %s = %d, expected %d\n", description, actual, expected);
 
-            printf("FAIL: propagate_nice(4) failed, errno=%d\n", errno);
+    report_check(description, 1, NULL);
 
-            status = 1;
+    return 0;
 
-        }
+}
 
-        wait(NULL); // wait for child to finish
+/*
 
-        int parent_nic = getpriority(PRIO_PROCESS, 0);
+ * propagate_nice(increment) returned ret, with errno err, and must have
 
-        int expected_parent = 0 + 4;
+ * succeeded.
 
-        int child_nic, grandchild_nic;
+ */
 
-        read(pipe_child[0], &child_nic, sizeof(child_nic));
+int check_success(int increment, int ret, int err) {
 
-        read(pipe_grandchild[0], &grandchild_nic, sizeof(grandchild_nic));
+    char description[64];
 
+    snprintf(description, sizeof(description), "propagate_nice(%d) succeeds", increment);
 
+    if (ret == -1) {
 
-        if (parent_nic != expected_parent) {
+        printf("FAIL: propagate_nice(%d) failed, errno=%d\n", increment, err);
 
-            printf("FAIL: Parent niceness = %d, expected %d\n", parent_nic, expected_parent);
+        report_check(description, 0, "returned -1, errno=%d", err);
 
-            status = 1;
+        return 1;
 
-        } else {
+    }
 
-            printf("PASS: Parent niceness = %d, expected %d\n", parent_nic, expected_parent);
+    printf("PASS: propagate_nice(%d) returned %d\n", increment, ret);
 
-        }
+    report_check(description, 1, NULL);
 
-        if (child_nic != 0 + 4/2) {
+    return 0;
 
-            printf("FAIL: Child niceness = %d, expected %d\n", child_nic, 2);
+}
 
-            status = 1;
+/*
 
-        } else {
+ * propagate_nice(increment) returned ret and must have failed, with errno
 
-            printf("PASS: Child niceness = %d, expected %d\n", child_nic, 2);
+ * expected_errno unless that is 0.
 
-        }
+ */
 
-        if (grandchild_nic != 0 + (4/2)/2) {
+int check_failure(int increment, int ret, int expected_errno) {
 
-            printf("FAIL: Grandchild niceness = %d, expected %d\n", grandchild_nic, 1);
+    int err = errno;
 
-            status = 1;
+    char description[64];
 
-        } else {
+    snprintf(description, sizeof(description), "propagate_nice(%d) fails", increment);
 
-            printf("PASS: Grandchild niceness = %d, expected %d\n", grandchild_nic, 1);
+    if (ret != -1 || (expected_errno && err != expected_errno)) {
 
-        }
+        printf("FAIL: propagate_nice(%d) returned %d, errno=%d; expected -1", increment, ret, err);
+
+        if (expected_errno)
+
+            printf(" with errno=%d", expected_errno);
+
+        printf("\n");
+
+        report_check(description, 0, "returned %d, errno=%d; expected -1 with errno=%d",
+
+                     ret, err, expected_errno);
+
+        return 1;
 
     }
 
-    return status;
+    printf("PASS: propagate_nice(%d) returned -1, errno=%d\n", increment, err);
 
-}
+    report_check(description, 1, NULL);
 
+    return 0;
 
+}
 
 /* -----------------------------------------------------------------
 
-   Test Case 2: Increment of 0
+   Test Case 1: Basic Functionality – Positive Increment with Live Children
 
-   Description: Call propagate_nice(0) on a process with niceness 10.
+   Description:
+
+     - Parent’s niceness increases by 4.
+
+     - Child receives floor(4/2)=2 increment.
+
+     - Grandchild receives floor(2/2)=1 increment.
 
    Expected:
 
-     - No change to niceness.
+     - Parent: 0 + 4 = 4.
 
-     - Return -1 (with errno==EINVAL).
+     - Child: 0 + 2 = 2.
+
+     - Grandchild: 0 + 1 = 1.
 
 ------------------------------------------------------------------*/
 
-int test_increment_of_zero() {
+int test_positive_increment_live_children() {
 
-    printf("\nTest 2: Increment of 0\n");
+    printf("\nTest 1: Positive Increment with Live Children\n");
 
-    if (setpriority(PRIO_PROCESS, 0, 10) == -1) {
+    int status = 0;
+
+    /* Set parent's niceness to 0 */
+
+    if (setpriority(PRIO_PROCESS, 0, 0) == -1) {
 
         perror("setpriority (parent)");
 
@@ -209,39 +251,35 @@ int test_increment_of_zero() {
 
     }
 
-    int ret = propagate_nice(0);
-
-    if (ret != -1) {
-
-        printf("FAIL: propagate_nice(0) returned %d, expected -1\n", ret);
+    struct proctree tree;
 
-        return 1;
+    if (spawn_tree(&tree, "parent(child(grandchild))", NULL, PROCTREE_FORK) == -1) return 1;
 
-    } else {
+    int ret = propagate_nice(4);
 
-        if (errno != EINVAL) {
+    int err = errno;
 
-            printf("FAIL: propagate_nice(0) errno=%d, expected %d (EINVAL)\n", errno, EINVAL);
+    proctree_release(&tree);
 
-            return 1;
+    proctree_finish(&tree);
 
-        }
+    int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-    }
+    int child_nic = tree_nice(&tree, "child");
 
-    int nic = getpriority(PRIO_PROCESS, 0);
+    int grandchild_nic = tree_nice(&tree, "grandchild");
 
-    if (nic != 10) {
+    proctree_destroy(&tree);
 
-        printf("FAIL: Parent niceness = %d, expected 10\n", nic);
+    status |= check_success(4, ret, err);
 
-        return 1;
+    status |= check_nice("Parent", parent_nic, 0 + 4);
 
-    }
+    status |= check_nice("Child", child_nic, 2);
 
-    printf("PASS: Output: Parent niceness = %d; Expected: 10; propagate_nice(0) returned error as expected\n", nic);
+    status |= check_nice("Grandchild", grandchild_nic, 1);
 
-    return 0;
+    return status;
 
 }
 
@@ -249,89 +287,91 @@ int test_increment_of_zero() {
 
 /* -----------------------------------------------------------------
 
-   Test Case 3: Maximum Niceness Clamping
+   Test Case 2: Increment of 0
 
-   Description: Parent starts at 18. Call propagate_nice(3).
+   Description: Call propagate_nice(0) on a process with niceness 10.
 
    Expected:
 
-     - Parent clamps to 19.
+     - No change to niceness.
 
-     - Child receives floor(3/2)=1 increment; if starting at 18, clamped to 19.
+     - Return -1 (with errno==EINVAL).
 
 ------------------------------------------------------------------*/
 
-int test_maximum_niceness_clamping() {
+int test_increment_of_zero() {
 
-    printf("\nTest 3: Maximum Niceness Clamping\n");
+    printf("\nTest 2: Increment of 0\n");
 
-    if (setpriority(PRIO_PROCESS, 0, 18) == -1) { perror("setpriority (parent)"); return 1; }
+    if (setpriority(PRIO_PROCESS, 0, 10) == -1) {
 
-    int pipe_child[2];
+        perror("setpriority (parent)");
 
-    if (pipe(pipe_child) == -1) { perror("pipe"); return 1; }
+        return 1;
 
-    pid_t child = fork();
+    }
 
-    if (child == -1) { perror("fork (child)"); return 1; }
+    int ret = propagate_nice(0);
 
-    if (child == 0) {
+    if (check_failure(0, ret, EINVAL))
 
-        sleep(2);
+        return 1;
 
-        int nic = getpriority(PRIO_PROCESS, 0);
+    return check_nice("Parent", getpriority(PRIO_PROCESS, 0), 10);
 
-        write(pipe_child[1], &nic, sizeof(nic));
+}
 
-        exit(0);
 
-    } else {
 
-        sleep(1);
+/* -----------------------------------------------------------------
 
-        int ret = propagate_nice(3);
+   Test Case 3: Maximum Niceness Clamping
 
-        if (ret == -1) {
+   Description: Parent starts at 18. Call propagate_nice(3).
 
-            printf("FAIL: propagate_nice(3) failed unexpectedly, errno=%d\n", errno);
+   Expected:
 
-            return 1;
+     - Parent clamps to 19.
 
-        }
+     - Child receives floor(3/2)=1 increment; if starting at 18, clamped to 19.
 
-        wait(NULL);
+------------------------------------------------------------------*/
 
-        int parent_nic = getpriority(PRIO_PROCESS, 0);
+int test_maximum_niceness_clamping() {
 
-        if (parent_nic != 19) {
+    printf("\nTest 3: Maximum Niceness Clamping\n");
 
-            printf("FAIL: Parent niceness = %d, expected 19\n", parent_nic);
+    if (setpriority(PRIO_PROCESS, 0, 18) == -1) { perror("setpriority (parent)"); return 1; }
 
-            return 1;
+    struct proctree tree;
 
-        } else {
+    if (spawn_tree(&tree, "parent(child)", NULL, PROCTREE_FORK) == -1) return 1;
 
-            printf("PASS: Parent niceness = %d, expected 19\n", parent_nic);
+    int ret = propagate_nice(3);
 
-        }
+    int err = errno;
 
-        int child_nic;
+    proctree_release(&tree);
 
-        read(pipe_child[0], &child_nic, sizeof(child_nic));
+    proctree_finish(&tree);
 
-        if (child_nic != 19) {
+    int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-            printf("FAIL: Child niceness = %d, expected 19\n", child_nic);
+    int child_nic = tree_nice(&tree, "child");
 
-            return 1;
+    proctree_destroy(&tree);
 
-        } else {
+    if (check_success(3, ret, err))
 
-            printf("PASS: Child niceness = %d, expected 19\n", child_nic);
+        return 1;
 
-        }
+    if (check_nice("Parent", parent_nic, 19))
 
-    }
+        return 1;
+
+    if (check_nice("Child", child_nic, 19))
+
+        return 1;
 
     return 0;
 
@@ -357,28 +397,16 @@ int test_minimum_niceness_clamping() {
 
     int ret = propagate_nice(5);
 
-    if (ret == -1) {
-
-        printf("FAIL: propagate_nice(5) failed unexpectedly, errno=%d\n", errno);
+    if (check_success(5, ret, errno))
 
         return 1;
 
-    }
-
     int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-    if (parent_nic != -15) {
-
-        printf("FAIL: Parent niceness = %d, expected -15\n", parent_nic);
+    if (check_nice("Parent", parent_nic, -15))
 
         return 1;
 
-    } else {
-
-        printf("PASS: Parent niceness = %d, expected -15\n", parent_nic);
-
-    }
-
     return 0;
 
 }
@@ -401,17 +429,7 @@ int test_negative_increment() {
 
     int ret = propagate_nice(-5);
 
-    if (ret != -1 || errno != EINVAL) {
-
-        printf("FAIL: propagate_nice(-5) returned %d, errno=%d; expected -1 with errno==EINVAL\n", ret, errno);
-
-        return 1;
-
-    }
-
-    printf("PASS: Output: propagate_nice(-5) returned -1 (errno=%d); Expected: -EINVAL\n", errno);
-
-    return 0;
+    return check_failure(-5, ret, EINVAL);
 
 }
 
@@ -439,87 +457,35 @@ int test_dead_child() {
 
     if (setpriority(PRIO_PROCESS, 0, 0) == -1) { perror("setpriority (parent)"); return 1; }
 
-    int pipe_live[2];
-
-    if (pipe(pipe_live) == -1) { perror("pipe_live"); return 1; }
-
-
-
-    /* Fork a dead child */
-
-    pid_t dead_child = fork();
-
-    if (dead_child == -1) { perror("fork (dead_child)"); return 1; }
-
-    if (dead_child == 0) {
-
-        exit(0);
-
-    }
-
-    /* Fork a live child */
-
-    pid_t live_child = fork();
-
-    if (live_child == -1) { perror("fork (live_child)"); return 1; }
-
-    if (live_child == 0) {
-
-        sleep(2);
-
-        int nic = getpriority(PRIO_PROCESS, 0);
-
-        write(pipe_live[1], &nic, sizeof(nic));
+    struct proctree tree;
 
-        exit(0);
-
-    }
-
-    sleep(1);
+    if (spawn_tree(&tree, "parent(dead*,live)", NULL, PROCTREE_FORK) == -1) return 1;
 
     int ret = propagate_nice(4);
 
-    if (ret == -1) {
+    int err = errno;
 
-        printf("FAIL: propagate_nice(4) failed, errno=%d\n", errno);
+    proctree_release(&tree);
 
-        return 1;
-
-    }
-
-    wait(NULL); /* dead child already exited */
-
-    wait(NULL); /* wait for live child */
+    proctree_finish(&tree);
 
     int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-    if (parent_nic != 4) {
-
-        printf("FAIL: Parent niceness = %d, expected %d\n", parent_nic, 4);
+    int live_nic = tree_nice(&tree, "live");
 
-        return 1;
-
-    } else {
+    proctree_destroy(&tree);
 
-        printf("PASS: Parent niceness = %d, expected %d\n", parent_nic, 4);
+    if (check_success(4, ret, err))
 
-    }
-
-    int live_nic;
-
-    read(pipe_live[0], &live_nic, sizeof(live_nic));
-
-    if (live_nic != 2) {
+        return 1;
 
-        printf("FAIL: Live child's niceness = %d, expected %d\n", live_nic, 2);
+    if (check_nice("Parent", parent_nic, 4))
 
         return 1;
 
-    } else {
-
-        printf("PASS: Live child's niceness = %d, expected %d\n", live_nic, 2);
+    if (check_nice("Live child", live_nic, 2))
 
-    }
+        return 1;
 
     return 0;
 
@@ -545,28 +511,16 @@ int test_no_children() {
 
     int ret = propagate_nice(4);
 
-    if (ret == -1) {
-
-        printf("FAIL: propagate_nice(4) failed, errno=%d\n", errno);
+    if (check_success(4, ret, errno))
 
         return 1;
 
-    }
-
     int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-    if (parent_nic != 4) {
-
-        printf("FAIL: Parent niceness = %d, expected %d\n", parent_nic, 4);
+    if (check_nice("Parent", parent_nic, 4))
 
         return 1;
 
-    } else {
-
-        printf("PASS: Parent niceness = %d, expected %d\n", parent_nic, 4);
-
-    }
-
     return 0;
 
 }
@@ -595,111 +549,97 @@ int test_multi_level_hierarchy() {
 
     if (setpriority(PRIO_PROCESS, 0, 0) == -1) { perror("setpriority (parent)"); return 1; }
 
-    int pipe_child[2], pipe_grandchild[2];
-
-    if (pipe(pipe_child) == -1) { perror("pipe_child"); return 1; }
-
-    if (pipe(pipe_grandchild) == -1) { perror("pipe_grandchild"); return 1; }
-
-
-
-    pid_t child = fork();
-
-    if (child == -1) { perror("fork (child)"); return 1; }
+    struct proctree tree;
 
-    if (child == 0) {
+    if (spawn_tree(&tree, "parent(child(grandchild))", NULL, PROCTREE_FORK) == -1) return 1;
 
-        /* Child process: fork grandchild */
+    int ret = propagate_nice(8);
 
-        pid_t grandchild = fork();
+    int err = errno;
 
-        if (grandchild == -1) { perror("fork (grandchild)"); exit(1); }
+    proctree_release(&tree);
 
-        if (grandchild == 0) {
+    proctree_finish(&tree);
 
-            sleep(2);
-
-            int nic = getpriority(PRIO_PROCESS, 0);
+    int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-            write(pipe_grandchild[1], &nic, sizeof(nic));
+    int child_nic = tree_nice(&tree, "child");
 
-            exit(0);
+    int grandchild_nic = tree_nice(&tree, "grandchild");
 
-        } else {
+    proctree_destroy(&tree);
 
-            sleep(2);
+    if (check_success(8, ret, err))
 
-            int nic = getpriority(PRIO_PROCESS, 0);
+        return 1;
 
-            write(pipe_child[1], &nic, sizeof(nic));
+    if (check_nice("Parent", parent_nic, 8))
 
-            wait(NULL);
+        return 1;
 
-            exit(0);
+    if (check_nice("Child", child_nic, 4))
 
-        }
+        return 1;
 
-    } else {
+    if (check_nice("Grandchild", grandchild_nic, 2))
 
-        sleep(1);
+        return 1;
 
-        int ret = propagate_nice(8);
+    return 0;
 
-        if (ret == -1) {
+}
 
-            printf("FAIL: propagate_nice(8) failed, errno=%d\n", errno);
 
-            return 1;
 
-        }
+/* -----------------------------------------------------------------
 
-        wait(NULL);
+   Test Case 9: Increment Halts at Zero
 
-        int parent_nic = getpriority(PRIO_PROCESS, 0);
+   Description: Call propagate_nice(1) on a process with children.
 
-        if (parent_nic != 8) {
+   Expected:
 
-            printf("FAIL: Parent niceness = %d, expected %d\n", parent_nic, 8);
+     - Parent: 0 + 1 = 1.
 
-            return 1;
+     - Child: floor(1/2) = 0 (no change).
 
-        } else {
+------------------------------------------------------------------*/
 
-            printf("PASS: Parent niceness = %d, expected %d\n", parent_nic, 8);
+int test_increment_halts_at_zero() {
 
-        }
+    printf("\nTest 9: Increment Halts at Zero\n");
 
-        int child_nic, grandchild_nic;
+    if (setpriority(PRIO_PROCESS, 0, 0) == -1) { perror("setpriority (parent)"); return 1; }
 
-        read(pipe_child[0], &child_nic, sizeof(child_nic));
+    struct proctree tree;
 
-        read(pipe_grandchild[0], &grandchild_nic, sizeof(grandchild_nic));
+    if (spawn_tree(&tree, "parent(child)", NULL, PROCTREE_FORK) == -1) return 1;
 
-        if (child_nic != 4) {
+    int ret = propagate_nice(1);
 
-            printf("FAIL: Child niceness = %d, expected %d\n", child_nic, 4);
+    int err = errno;
 
-            return 1;
+    proctree_release(&tree);
 
-        } else {
+    proctree_finish(&tree);
 
-            printf("PASS: Child niceness = %d, expected %d\n", child_nic, 4);
+    int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-        }
+    int child_nic = tree_nice(&tree, "child");
 
-        if (grandchild_nic != 2) {
+    proctree_destroy(&tree);
 
-            printf("FAIL: Grandchild niceness = %d, expected %d\n", grandchild_nic, 2);
+    if (check_success(1, ret, err))
 
-            return 1;
+        return 1;
 
-        } else {
+    if (check_nice("Parent", parent_nic, 1))
 
-            printf("PASS: Grandchild niceness = %d, expected %d\n", grandchild_nic, 2);
+        return 1;
 
-        }
+    if (check_nice("Child", child_nic, 0))
 
-    }
+        return 1;
 
     return 0;
 
@@ -709,89 +649,71 @@ int test_multi_level_hierarchy() {
 
 /* -----------------------------------------------------------------
 
-   Test Case 9: Increment Halts at Zero
-
-   Description: Call propagate_nice(1) on a process with children.
-
-   Expected:
-
-     - Parent: 0 + 1 = 1.
-
-     - Child: floor(1/2) = 0 (no change).
-
-------------------------------------------------------------------*/
-
-int test_increment_halts_at_zero() {
-
-    printf("\nTest 9: Increment Halts at Zero\n");
-
-    if (setpriority(PRIO_PROCESS, 0, 0) == -1) { perror("setpriority (parent)"); return 1; }
-
-    int pipe_child[2];
+   Test Case 10: Deep Propagation
 
-    if (pipe(pipe_child) == -1) { perror("pipe_child"); return 1; }
+   Description: Process chain: P1 → P2 → P3 → P4.
 
-    pid_t child = fork();
+   Call propagate_nice(8) on P1.
 
-    if (child == -1) { perror("fork (child)"); return 1; }
+   Expected:
 
-    if (child == 0) {
+     - P1: 0 + 8 = 8.
 
-        sleep(2);
+     - P2: 0 + floor(8/2)=4.
 
-        int nic = getpriority(PRIO_PROCESS, 0);
+     - P3: 0 + floor(4/2)=2.
 
-        write(pipe_child[1], &nic, sizeof(nic));
+     - P4: 0 + floor(2/2)=1.
 
-        exit(0);
+------------------------------------------------------------------*/
 
-    } else {
+int test_deep_propagation() {
 
-        sleep(1);
+    printf("\nTest 10: Deep Propagation\n");
 
-        int ret = propagate_nice(1);
+    if (setpriority(PRIO_PROCESS, 0, 0) == -1) { perror("setpriority (parent)"); return 1; }
 
-        if (ret == -1) {
+    struct proctree tree;
 
-            printf("FAIL: propagate_nice(1) failed, errno=%d\n", errno);
+    if (spawn_tree(&tree, "P1(P2(P3(P4)))", NULL, PROCTREE_FORK) == -1) return 1;
 
-            return 1;
+    int ret = propagate_nice(8);
 
-        }
+    int err = errno;
 
-        wait(NULL);
+    proctree_release(&tree);
 
-        int parent_nic = getpriority(PRIO_PROCESS, 0);
+    proctree_finish(&tree);
 
-        if (parent_nic != 1) {
+    int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-            printf("FAIL: Parent niceness = %d, expected %d\n", parent_nic, 1);
+    int p2_nic = tree_nice(&tree, "P2");
 
-            return 1;
+    int p3_nic = tree_nice(&tree, "P3");
 
-        } else {
+    int p4_nic = tree_nice(&tree, "P4");
 
-            printf("PASS: Parent niceness = %d, expected %d\n", parent_nic, 1);
+    proctree_destroy(&tree);
 
-        }
+    if (check_success(8, ret, err))
 
-        int child_nic;
+        return 1;
 
-        read(pipe_child[0], &child_nic, sizeof(child_nic));
+    if (check_nice("Parent", parent_nic, 8))
 
-        if (child_nic != 0) {
+        return 1;
 
-            printf("FAIL: Child niceness = %d, expected %d\n", child_nic, 0);
+    if (check_nice("P2", p2_nic, 4))
 
-            return 1;
+        return 1;
 
-        } else {
+    if (check_nice("P3", p3_nic, 2))
 
-            printf("PASS: Child niceness = %d, expected %d\n", child_nic, 0);
+        return 1;
 
-        }
+    if (check_nice("P4", p4_nic, 1))
 
-    }
+        return 1;
 
     return 0;
 
@@ -801,362 +723,336 @@ int test_increment_halts_at_zero() {
 
 /* -----------------------------------------------------------------
 
-   Test Case 10: Deep Propagation
-
-   Description: Process chain: P1 → P2 → P3 → P4.
-
-   Call propagate_nice(8) on P1.
-
-   Expected:
+   Test Case 12: No Changes Anywhere
 
-     - P1: 0 + 8 = 8.
+   Description: Process with no children and niceness 19.
 
-     - P2: 0 + floor(8/2)=4.
+   Expected: propagate_nice(0) returns -1.
 
-     - P3: 0 + floor(4/2)=2.
+------------------------------------------------------------------*/
 
-     - P4: 0 + floor(2/2)=1.
+int test_no_changes_anywhere() {
 
-------------------------------------------------------------------*/
+    printf("\nTest 12: No Changes Anywhere\n");
 
-int test_deep_propagation() {
+    if (setpriority(PRIO_PROCESS, 0, 19) == -1) { perror("setpriority (parent)"); return 1; }
 
-    printf("\nTest 10: Deep Propagation\n");
+    int ret = propagate_nice(0);
 
-    if (setpriority(PRIO_PROCESS, 0, 0) == -1) { perror("setpriority (parent)"); return 1; }
+    if (check_failure(0, ret, 0))
 
-    int pipe_p2[2], pipe_p3[2], pipe_p4[2];
+        return 1;
 
-    if (pipe(pipe_p2)==-1) { perror("pipe_p2"); return 1; }
+    return check_nice("Parent", getpriority(PRIO_PROCESS, 0), 19);
 
-    if (pipe(pipe_p3)==-1) { perror("pipe_p3"); return 1; }
+}
 
-    if (pipe(pipe_p4)==-1) { perror("pipe_p4"); return 1; }
 
-    pid_t p2 = fork();
 
-    if (p2 == -1) { perror("fork (P2)"); return 1; }
+/* -----------------------------------------------------------------
 
-    if (p2 == 0) {
+   Test Case 13: Partial Success
 
-        /* P2: fork P3 */
+   Description:
 
-        pid_t p3 = fork();
+     - Process with one live child (initial niceness 19) and one dead child.
 
-        if (p3 == -1) { perror("fork (P3)"); exit(1); }
+     - Parent starts at 10.
 
-        if (p3 == 0) {
+   Expected:
 
-            /* P3: fork P4 */
+     - Parent: 10 + 2 = 12.
 
-            pid_t p4 = fork();
+     - Live child remains at 19 (clamped).
 
-            if (p4 == -1) { perror("fork (P4)"); exit(1); }
+------------------------------------------------------------------*/
 
-            if (p4 == 0) {
+/*
 
-                sleep(2);
+ * Tree-node setup for test 13: the live child starts at niceness 19.
 
-                int nic = getpriority(PRIO_PROCESS, 0);
+ */
 
-                write(pipe_p4[1], &nic, sizeof(nic));
+int partial_success_setup(struct proctree *tree, int idx, void *arg) {
 
-                exit(0);
+    (void)arg;
 
-            } else {
+    if (strcmp(tree->nodes[idx].name, "live") == 0 && setpriority(PRIO_PROCESS, 0, 19) == -1)
 
-                sleep(2);
+        perror("setpriority (live child)");
 
-                int nic = getpriority(PRIO_PROCESS, 0);
+    return 0;
 
-                write(pipe_p3[1], &nic, sizeof(nic));
+}
 
-                wait(NULL);
+int test_partial_success() {
 
-                exit(0);
+    printf("\nTest 13: Partial Success\n");
 
-            }
+    if (setpriority(PRIO_PROCESS, 0, 10) == -1) { perror("setpriority (parent)"); return 1; }
 
-        } else {
+    struct proctree tree;
 
-            sleep(2);
+    if (spawn_tree(&tree, "parent(dead*,live)", partial_success_setup, PROCTREE_FORK) == -1) return 1;
 
-            int nic = getpriority(PRIO_PROCESS, 0);
+    int ret = propagate_nice(2);
 
-            write(pipe_p2[1], &nic, sizeof(nic));
+    int err = errno;
 
-            wait(NULL);
+    proctree_release(&tree);
 
-            exit(0);
+    proctree_finish(&tree);
 
-        }
+    int parent_nic = getpriority(PRIO_PROCESS, 0);
 
-    } else {
+    int live_nic = tree_nice(&tree, "live");
 
-        sleep(1);
+    proctree_destroy(&tree);
 
-        int ret = propagate_nice(8);
+    if (check_success(2, ret, err))
 
-        if (ret == -1) {
+        return 1;
 
-            printf("FAIL: propagate_nice(8) failed, errno=%d\n", errno);
+    if (check_nice("Parent", parent_nic, 12))
 
-            return 1;
+        return 1;
 
-        }
+    if (check_nice("Live child", live_nic, 19))
 
-        wait(NULL);
+        return 1;
 
-        int parent_nic = getpriority(PRIO_PROCESS, 0);
+    return 0;
 
-        if (parent_nic != 8) {
+}
 
-            printf("FAIL: Parent niceness = %d, expected %d\n", parent_nic, 8);
 
-            return 1;
 
-        } else {
+/* -----------------------------------------------------------------
 
-            printf("PASS: Parent niceness = %d, expected %d\n", parent_nic, 8);
+   Test Case 14: Large Tree Checked Against the Model
 
-        }
+   Description:
 
-        int p2_nic, p3_nic, p4_nic;
+     - A tree of 6 children x 4 grandchildren x 4 great-grandchildren
 
-        read(pipe_p2[0], &p2_nic, sizeof(p2_nic));
+       (126 live descendants) with mixed starting niceness, some close to
 
-        read(pipe_p3[0], &p3_nic, sizeof(p3_nic));
+       the clamp, plus one dead child under every non-leaf process.
 
-        read(pipe_p4[0], &p4_nic, sizeof(p4_nic));
+     - propagate_nice(8) is called by the root.
 
-        if (p2_nic != 4) {
+   Expected:
 
-            printf("FAIL: P2 niceness = %d, expected 4\n", p2_nic);
+     - Every process matches the userspace model (propagate_nice_model.h)
 
-            return 1;
+       applied to a snapshot of the tree taken just before the call.
 
-        } else {
+------------------------------------------------------------------*/
 
-            printf("PASS: P2 niceness = %d, expected 4\n", p2_nic);
+static const int large_tree_fanout[] = { 6, 4, 4 };
 
-        }
+#define LARGE_TREE_LEVELS 3
 
-        if (p3_nic != 2) {
+/*
 
-            printf("FAIL: P3 niceness = %d, expected 2\n", p3_nic);
+ * Append the spec of a large-tree node at `level` (0 = the test process)
 
-            return 1;
+ * and its subtree to p; every non-leaf also gets one dead child.
 
-        } else {
+ */
 
-            printf("PASS: P3 niceness = %d, expected 2\n", p3_nic);
+char *large_tree_spec(char *p, int level, int *next) {
 
-        }
+    p += sprintf(p, "n%d", (*next)++);
 
-        if (p4_nic != 1) {
+    if (level < LARGE_TREE_LEVELS) {
 
-            printf("FAIL: P4 niceness = %d, expected 1\n", p4_nic);
+        *p++ = '(';
 
-            return 1;
+        for (int i = 0; i < large_tree_fanout[level]; i++) {
 
-        } else {
+            p = large_tree_spec(p, level + 1, next);
 
-            printf("PASS: P4 niceness = %d, expected 1\n", p4_nic);
+            *p++ = ',';
 
         }
 
+        p += sprintf(p, "n%d*)", (*next)++);
+
     }
 
-    return 0;
+    return p;
 
 }
 
+/*
 
+ * Tree-node setup for the large tree: raise the inherited niceness by a
 
-/* -----------------------------------------------------------------
-
-   Test Case 12: No Changes Anywhere
-
-   Description: Process with no children and niceness 19.
-
-   Expected: propagate_nice(0) returns -1.
-
-------------------------------------------------------------------*/
-
-int test_no_changes_anywhere() {
-
-    printf("\nTest 12: No Changes Anywhere\n");
-
-    if (setpriority(PRIO_PROCESS, 0, 19) == -1) { perror("setpriority (parent)"); return 1; }
+ * few steps. It only ever goes up, so no privilege is needed.
 
-    int ret = propagate_nice(0);
+ */
 
-    if (ret != -1) {
+int large_tree_setup(struct proctree *tree, int idx, void *arg) {
 
-        printf("FAIL: propagate_nice(0) returned %d, expected -1\n", ret);
+    (void)tree; (void)arg;
 
-        return 1;
+    int nic = getpriority(PRIO_PROCESS, 0) + (idx * 5) % 7;
 
-    }
-
-    printf("PASS: Output: propagate_nice(0) returned -1 as expected; Parent niceness remains %d\n", getpriority(PRIO_PROCESS, 0));
+    setpriority(PRIO_PROCESS, 0, nic > 19 ? 19 : nic);
 
     return 0;
 
 }
 
+int test_large_tree_model() {
 
+    printf("\nTest 14: Large Tree Checked Against the Model\n");
 
-/* -----------------------------------------------------------------
-
-   Test Case 13: Partial Success
-
-   Description:
-
-     - Process with one live child (initial niceness 19) and one dead child.
-
-     - Parent starts at 10.
-
-   Expected:
+    if (setpriority(PRIO_PROCESS, 0, 0) == -1) { perror("setpriority (parent)"); return 1; }
 
-     - Parent: 10 + 2 = 12.
+    char spec[4096];
 
-     - Live child remains at 19 (clamped).
+    int next = 0;
 
-------------------------------------------------------------------*/
+    large_tree_spec(spec, 0, &next);
 
-int test_partial_success() {
+    struct proctree tree;
 
-    printf("\nTest 13: Partial Success\n");
+    if (spawn_tree(&tree, spec, large_tree_setup, PROCTREE_CLONE_VM) == -1) return 1;
 
-    if (setpriority(PRIO_PROCESS, 0, 10) == -1) { perror("setpriority (parent)"); return 1; }
+    int status = 0;
 
-    int pipe_live[2];
+    struct pn_snapshot snap;
 
-    if (pipe(pipe_live) == -1) { perror("pipe_live"); return 1; }
+    if (pn_snapshot_take(&snap, 0) == -1) {
 
+        printf("FAIL: could not snapshot the process tree\n");
 
+        report_check("snapshot the process tree", 0, "errno=%d", errno);
 
-    pid_t dead_child = fork();
+        proctree_release(&tree);
 
-    if (dead_child == -1) { perror("fork (dead_child)"); return 1; }
+        proctree_finish(&tree);
 
-    if (dead_child == 0) {
+        proctree_destroy(&tree);
 
-        exit(0);
+        return 1;
 
     }
 
-    pid_t live_child = fork();
+    if (snap.n != (size_t)tree.live + 1) {
 
-    if (live_child == -1) { perror("fork (live_child)"); return 1; }
+        printf("FAIL: snapshot has %zu processes, expected %d\n", snap.n, tree.live + 1);
 
-    if (live_child == 0) {
+        report_check("snapshot size", 0, "%zu processes, expected %d", snap.n, tree.live + 1);
 
-        /* In live child, set niceness to 19 */
+        status = 1;
 
-        if (setpriority(PRIO_PROCESS, 0, 19) == -1) { perror("setpriority (live child)"); exit(1); }
+    }
 
-        sleep(2);
+    pn_model_apply(&snap, 8);
 
-        int nic = getpriority(PRIO_PROCESS, 0);
+    int ret = propagate_nice(8);
 
-        write(pipe_live[1], &nic, sizeof(nic));
+    if (check_success(8, ret, errno)) {
 
-        exit(0);
+        status = 1;
 
-    }
+    } else if (pn_verify(&snap) != 0) {
 
-    sleep(1);
+        report_check("every process matches the model", 0, "see the test output");
 
-    int ret = propagate_nice(2);
+        status = 1;
 
-    if (ret == -1) {
+    } else {
 
-        printf("FAIL: propagate_nice(2) failed, errno=%d\n", errno);
+        printf("PASS: all %zu processes match the model\n", snap.n);
 
-        return 1;
+        report_check("every process matches the model", 1, NULL);
 
     }
 
-    wait(NULL); /* dead child */
+    proctree_release(&tree);
 
-    wait(NULL); /* live child */
+    proctree_finish(&tree);
 
-    int parent_nic = getpriority(PRIO_PROCESS, 0);
+    proctree_destroy(&tree);
 
-    if (parent_nic != 12) {
+    pn_snapshot_free(&snap);
 
-        printf("FAIL: Parent niceness = %d, expected 12\n", parent_nic);
+    return status;
 
-        return 1;
+}
 
-    } else {
+static const struct runner_test tests[] = {
 
-        printf("PASS: Parent niceness = %d, expected 12\n", parent_nic);
+    { "test_positive_increment_live_children", test_positive_increment_live_children },
 
-    }
+    { "test_increment_of_zero", test_increment_of_zero },
 
-    int live_nic;
+    { "test_maximum_niceness_clamping", test_maximum_niceness_clamping },
 
-    read(pipe_live[0], &live_nic, sizeof(live_nic));
+    { "test_minimum_niceness_clamping", test_minimum_niceness_clamping },
 
-    if (live_nic != 19) {
+    { "test_negative_increment", test_negative_increment },
 
-        printf("FAIL: Live child's niceness = %d, expected 19\n", live_nic);
+    { "test_dead_child", test_dead_child },
 
-        return 1;
+    { "test_no_children", test_no_children },
 
-    } else {
+    { "test_multi_level_hierarchy", test_multi_level_hierarchy },
 
-        printf("PASS: Live child's niceness = %d, expected 19\n", live_nic);
+    { "test_increment_halts_at_zero", test_increment_halts_at_zero },
 
-    }
+    { "test_deep_propagation", test_deep_propagation },
 
-    return 0;
+    { "test_no_changes_anywhere", test_no_changes_anywhere },
 
-}
+    { "test_partial_success", test_partial_success },
 
+    { "test_large_tree_model", test_large_tree_model },
 
+};
 
 /* -----------------------------------------------------------------
 
    Main: Run all tests
 
-------------------------------------------------------------------*/
-
-int main(void) {
+   By default every test runs in its own worker (in a fresh PID namespace
 
-    int total_failures = 0;
+   when permitted), concurrently on all CPUs. -s runs them serially in
 
+   this process and -j N limits the number of concurrent workers.
 
+------------------------------------------------------------------*/
 
-    total_failures += test_positive_increment_live_children();
+int main(int argc, char **argv) {
 
-    total_failures += test_increment_of_zero();
+    int total_failures = 0;
 
-    total_failures += test_maximum_niceness_clamping();
+    struct runner_opts opts = { .new_pidns = 1, .subreaper = 1,
 
-    total_failures += test_minimum_niceness_clamping();
+                                .on_start = report_test_begin, .on_finish = report_test_end };
 
-    total_failures += test_negative_increment();
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
 
-    total_failures += test_dead_child();
+    int serial = runner_parse_args(argc, argv, &opts);
 
-    total_failures += test_no_children();
+    report_open("task2_test_new");
 
-    total_failures += test_multi_level_hierarchy();
+    if (serial)
 
-    total_failures += test_increment_halts_at_zero();
+        total_failures = runner_run_serial(tests, ntests, &opts);
 
-    total_failures += test_deep_propagation();
+    else
 
-    total_failures += test_no_changes_anywhere();
+        total_failures = runner_run(tests, ntests, &opts);
 
-    total_failures += test_partial_success();
+    report_close();
 
     printf("\nSummary: %d test(s) failed.\n", total_failures);
 
     return total_failures;
 
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -42,6 +42,7 @@
 #include <sys/resource.h>
 #include <sys/syscall.h>
 #include <errno.h>
+#include "../common/report.h"
 
 #ifndef SYS_PROPAGATE_NICE
 #define SYS_PROPAGATE_NICE 464
@@ -49,12 +50,22 @@
 
 static int tests_failed = 0;
 
+/* The syscall, timed for the structured report */
+long propagate_nice(int n) {
+    uint64_t start = report_now_ns();
+    long ret = syscall(SYS_PROPAGATE_NICE, n);
+    report_syscall("propagate_nice", start, ret);
+    return ret;
+}
+
 /* Helper function to compare expected and actual nice values */
 void check_test_value(const char *desc, int expected, int actual) {
     if (expected == actual) {
         printf("[PASS] %s: expected %d, got %d\n", desc, expected, actual);
+        report_check(desc, 1, NULL);
     } else {
         printf("[FAIL] %s: expected %d, got %d\n", desc, expected, actual);
+        report_check(desc, 0, "expected %d, got %d", expected, actual);
         tests_failed++;
     }
 }
@@ -74,11 +85,13 @@ void test_negative_increment() {
     printf("\nRunning negative increment test...\n");
     reset_nice();
     errno = 0;
-    long ret = syscall(SYS_PROPAGATE_NICE, -1);
+    long ret = propagate_nice(-1);
     if (ret == -1 && errno != 0) {
         printf("[PASS] Negative increment test: syscall failed as expected (errno = %d).\n", errno);
+        report_check("Negative increment test", 1, NULL);
     } else {
         printf("[FAIL] Negative increment test: expected failure, got %ld\n", ret);
+        report_check("Negative increment test", 0, "expected failure, got %ld", ret);
         tests_failed++;
     }
 }
@@ -137,9 +150,10 @@ void test_propagate_nice_live() {
         // Parent process
         sleep(1);  // Give children time to set up
         errno = 0;
-        long ret = syscall(SYS_PROPAGATE_NICE, 4);
+        long ret = propagate_nice(4);
         if (ret != 0) {
             printf("[FAIL] Live chain: propagate_nice returned %ld (expected 0).\n", ret);
+            report_check("Live chain: propagate_nice(4)", 0, "returned %ld (expected 0)", ret);
             tests_failed++;
         }
         // Signal children to proceed
@@ -211,9 +225,10 @@ void test_propagate_nice_broken() {
         // Wait long enough to ensure Child has exited and reparenting occurs.
         sleep(2);
         errno = 0;
-        long ret = syscall(SYS_PROPAGATE_NICE, 2);
+        long ret = propagate_nice(2);
         if (ret != 0) {
             printf("[FAIL] Broken chain: propagate_nice returned %ld (expected 0).\n", ret);
+            report_check("Broken chain: propagate_nice(2)", 0, "returned %ld (expected 0)", ret);
             tests_failed++;
         }
         // Signal the grandchild to proceed.
@@ -236,12 +251,23 @@ void test_propagate_nice_broken() {
     }
 }
 
+/* Run one test, recording its failures and duration in the structured report */
+void run_test(const char *name, void (*fn)(void)) {
+    int failed_before = tests_failed;
+    uint64_t start = report_now_ns();
+    report_test_begin(name);
+    fn();
+    report_test_end(name, tests_failed - failed_before, report_now_ns() - start);
+}
+
 int main(void) {
     printf("Starting sys_propagate_nice tests\n");
+    report_open("task2_tests");
 
-    test_negative_increment();
-    test_propagate_nice_live();
-    test_propagate_nice_broken();
+    run_test("test_negative_increment", test_negative_increment);
+    run_test("test_propagate_nice_live", test_propagate_nice_live);
+    run_test("test_propagate_nice_broken", test_propagate_nice_broken);
+    report_close();
 
     if (tests_failed == 0) {
         printf("\nAll tests PASSED.\n");
@@ -0,0 +1,185 @@
+/* tree_spawn_bench.c
+
+   Spawn-throughput benchmark for the process-tree builder
+   (../common/proctree.h), which the large-tree tests and benchmarks use
+   to set up their trees.
+
+   Every shape (per-level fan-outs, as in propagate_nice_bench) is built
+   `repeats` times in each of three ways:
+
+     fork      every node is a fork() of its parent;
+     clone_vm  every node is a clone(CLONE_VM) sharing the caller's memory,
+               so no page tables are copied;
+     pool      as clone_vm, but the root's children are idle stubs taken
+               from a pool created beforehand (not included in the timing).
+
+   For each, the report gives the p50 time from proctree_spawn() until
+   every node is parked, the resulting processes per second, and the p50
+   time to release and tear down the tree. fork() gets slower the larger
+   the caller's address space; -b touches that many MiB of ballast first
+   to mimic a big test process.
+
+   Compile with:
+       gcc -O2 -Wall -o tree_spawn_bench tree_spawn_bench.c
+
+   Usage:
+       ./tree_spawn_bench [-r repeats] [-b ballast_mib] [shape ...]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include "../common/bench.h"
+#include "../common/proctree.h"
+
+static const char *default_shapes[] = {
+    "10", "100", "1000", "10000", "100,100", "10,10,10,10",
+};
+
+static int repeats = 5;
+static long ballast_mib = 0;
+
+enum { MODE_FORK, MODE_CLONE_VM, MODE_POOL, NMODES };
+static const char *mode_names[] = { "fork", "clone_vm", "pool" };
+
+struct shape {
+    const char *spec;           /* as given, e.g. "100,100" */
+    int levels;
+    int fanout[PROCTREE_MAX_LEVELS];
+    char *tree_spec;            /* proctree spec */
+};
+
+/* The root alone ("0") has nothing to spawn, and no children for a pool. */
+static int parse_shape(const char *spec, struct shape *s) {
+    s->spec = spec;
+    s->levels = proctree_parse_shape(spec, s->fanout, NULL);
+    if (s->levels < 1)
+        return -1;
+    s->tree_spec = proctree_fanout_spec(s->fanout, s->levels);
+    return s->tree_spec ? 0 : -1;
+}
+
+/* Build and tear down shape s once in the given mode, adding the spawn
+   and teardown times. Returns 0 or -1. */
+static int run_once(const struct shape *s, int mode, struct proctree_pool *pool,
+                    uint64_t *spawn_ns, uint64_t *teardown_ns, int *nodes) {
+    struct proctree tree;
+    if (proctree_create(&tree, s->tree_spec) == -1) {
+        perror("proctree_create");
+        return -1;
+    }
+    tree.mode = mode == MODE_FORK ? PROCTREE_FORK : PROCTREE_CLONE_VM;
+    if (mode == MODE_POOL)
+        tree.pool = pool;
+    *nodes = tree.n - 1;
+
+    uint64_t t0 = bench_now_ns();
+    if (proctree_spawn(&tree, NULL, NULL, NULL) == -1) {
+        proctree_destroy(&tree);
+        return -1;
+    }
+    uint64_t t1 = bench_now_ns();
+    proctree_release(&tree);
+    int killed = proctree_finish(&tree);
+    uint64_t t2 = bench_now_ns();
+    proctree_destroy(&tree);
+
+    *spawn_ns = t1 - t0;
+    *teardown_ns = t2 - t1;
+    return killed ? -1 : 0;
+}
+
+static int run_shape(const struct shape *s) {
+    uint64_t spawn[repeats], teardown[repeats];
+    int failures = 0;
+
+    for (int mode = 0; mode < NMODES; mode++) {
+        struct proctree_pool pool;
+        uint64_t pool_ns = 0;
+        int nodes = 0, taken = 0;
+
+        if (mode == MODE_POOL) {
+            uint64_t t0 = bench_now_ns();
+            if (proctree_pool_create(&pool, s->fanout[0]) == -1) {
+                perror("proctree_pool_create");
+                return 1;
+            }
+            pool_ns = bench_now_ns() - t0;
+        }
+        for (int r = 0; r < repeats; r++) {
+            if (run_once(s, mode, &pool, &spawn[taken], &teardown[taken], &nodes) == -1) {
+                fprintf(stderr, "%s (%s): tree did not come up or tear down cleanly\n",
+                        s->spec, mode_names[mode]);
+                failures++;
+                break;
+            }
+            taken++;
+        }
+        if (mode == MODE_POOL)
+            proctree_pool_destroy(&pool);
+        if (taken == 0)
+            continue;
+
+        struct bench_summary sp, td;
+        bench_summarize(spawn, taken, &sp);
+        bench_summarize(teardown, taken, &td);
+        printf("%-14s %-9s %8d %4d %12.2f %12.0f %12.2f", s->spec, mode_names[mode], nodes, taken,
+               sp.p50 / 1e6, sp.p50 ? nodes / (sp.p50 / 1e9) : 0.0, td.p50 / 1e6);
+        if (mode == MODE_POOL)
+            printf("   (pool of %d: %.2f ms)", s->fanout[0], pool_ns / 1e6);
+        printf("\n");
+        fflush(stdout);
+    }
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "r:b:")) != -1) {
+        switch (opt) {
+        case 'r': repeats = atoi(optarg); break;
+        case 'b': ballast_mib = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-r repeats] [-b ballast_mib] [shape ...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (repeats < 1 || ballast_mib < 0) {
+        fprintf(stderr, "repeats must be >= 1 and ballast_mib >= 0\n");
+        return EXIT_FAILURE;
+    }
+
+    const char **specs = (const char **)argv + optind;
+    int nspecs = argc - optind;
+    if (nspecs == 0) {
+        specs = default_shapes;
+        nspecs = sizeof(default_shapes) / sizeof(default_shapes[0]);
+    }
+
+    if (ballast_mib > 0) {
+        size_t size = (size_t)ballast_mib << 20;
+        char *ballast = malloc(size);
+        if (!ballast) {
+            perror("malloc");
+            return EXIT_FAILURE;
+        }
+        memset(ballast, 1, size);
+    }
+
+    int failures = 0;
+    printf("%-14s %-9s %8s %4s %12s %12s %12s\n", "shape", "mode", "nodes", "n",
+           "spawn(ms)", "procs/s", "teardown(ms)");
+    for (int i = 0; i < nspecs; i++) {
+        struct shape s;
+        if (parse_shape(specs[i], &s) == -1) {
+            fprintf(stderr, "bad shape \"%s\": expected fan-outs like 100,100\n", specs[i]);
+            failures++;
+            continue;
+        }
+        failures += run_shape(&s);
+        free(s.tree_spec);
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
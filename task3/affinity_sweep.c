@@ -0,0 +1,211 @@
+/* affinity_sweep.c
+
+   Sweeps the affinity of this process over subsets of the CPUs it may use
+   (sched_getaffinity) and checks the epoch CPU list of its schedstat at
+   every step, on any number of cores.
+
+   With up to -m CPUs (12 by default) every non-empty subset is visited, in
+   Gray-code order: step i uses the subset whose bits are i ^ (i >> 1), so
+   consecutive subsets differ by exactly one CPU and most steps need no
+   migration at all. With more CPUs than that, exhaustive enumeration is out
+   of reach (2^64 subsets on a 64-core host), so a random walk of -s steps
+   is taken instead, still adding or removing one random CPU per step and
+   never emptying the set.
+
+   At every step the process sets the subset, spins for -t microseconds,
+   and reads /proc/self/schedstat. The CPU it is running on must be in the
+   subset and in the CPU list; and the list may only hold CPUs that were in
+   some subset since the last epoch reset (resets are recognised as in
+   epoch_detect.h). On kernels without the CPU list only the first part is
+   checked.
+
+   Compile with:
+       gcc -O2 -Wall -o affinity_sweep affinity_sweep.c
+
+   Usage:
+       ./affinity_sweep [-m max_exhaustive_cpus] [-s steps] [-t spin_us] [-S seed]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "../common/bench.h"
+#include "cpulist.h"
+#include "epoch_detect.h"
+
+static int max_exhaustive = 12;
+static long walk_steps = 4096;
+static long spin_us = 200;
+static unsigned int seed = 1;
+
+static int cpus[CPU_SETSIZE], ncpus;
+
+/* The subset of cpus[] selected by the bits of code (low bits only). */
+static void subset_of(unsigned long long code, cpu_set_t *set) {
+    CPU_ZERO(set);
+    for (int j = 0; j < ncpus && j < 64; j++)
+        if (code >> j & 1)
+            CPU_SET(cpus[j], set);
+}
+
+struct sweep {
+    struct epoch_detector d;
+    struct schedstat_reader r;
+    cpu_set_t since_reset;      /* every CPU allowed since the last reset */
+    int have_list;
+    int last_cpu;
+    long steps, migrations, resets, failures;
+};
+
+static void fail(struct sweep *w, const cpu_set_t *set, const char *what, int cpu,
+                 const struct schedstat_sample *s) {
+    char list[256];
+    if (w->failures++ >= 10)
+        return;
+    cpulist_format(set, sizeof(*set), list, sizeof(list));
+    printf("[FAIL] step %ld, subset %s: %s CPU %d (CPU list %.*s)\n", w->steps, list, what, cpu,
+           s && s->cpu_list ? (int)s->cpu_list_len : 6, s && s->cpu_list ? s->cpu_list : "(none)");
+}
+
+/* Apply one subset and check the result. */
+static int step(struct sweep *w, const cpu_set_t *set) {
+    struct schedstat_sample s;
+    struct epoch_reset reset;
+    volatile unsigned long dummy = 0;
+
+    if (sched_setaffinity(0, sizeof(*set), set) == -1) {
+        perror("sched_setaffinity");
+        return -1;
+    }
+    CPU_OR(&w->since_reset, &w->since_reset, set);
+    uint64_t until = bench_now_ns() + (uint64_t)spin_us * 1000;
+    while (bench_now_ns() < until)
+        dummy++;
+
+    int cpu = sched_getcpu();
+    uint64_t now = bench_now_ns();
+    if (schedstat_read(&w->r, &s) == -1) {
+        perror("read schedstat");
+        return -1;
+    }
+    w->steps++;
+    if (cpu != w->last_cpu && w->last_cpu >= 0)
+        w->migrations++;
+    w->last_cpu = cpu;
+    if (!CPU_ISSET(cpu, set))
+        fail(w, set, "running outside the subset on", cpu, &s);
+
+    if (!w->have_list)
+        return 0;
+    int ret = epoch_detector_feed(&w->d, &s, now, &reset);
+    if (ret == -1) {
+        if (errno != ENOTSUP) {
+            perror("parse CPU list");
+            return -1;
+        }
+        w->have_list = 0;
+        return 0;
+    }
+    const cpu_set_t *list = w->d.prev;  /* the sample just fed */
+    if (ret == 1) {
+        /* The epoch rolled over during this step or the one before. */
+        w->resets++;
+        CPU_ZERO(&w->since_reset);
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET_S(c, w->d.setsize, list))
+                CPU_SET(c, &w->since_reset);
+        CPU_OR(&w->since_reset, &w->since_reset, set);
+    }
+    if (!CPU_ISSET_S(cpu, w->d.setsize, list))
+        fail(w, set, "list misses the current", cpu, &s);
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET_S(c, w->d.setsize, list) && !CPU_ISSET(c, &w->since_reset))
+            fail(w, set, "list has never-allowed", c, &s);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "m:s:t:S:")) != -1) {
+        switch (opt) {
+        case 'm': max_exhaustive = atoi(optarg); break;
+        case 's': walk_steps = atol(optarg); break;
+        case 't': spin_us = atol(optarg); break;
+        case 'S': seed = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "Usage: %s [-m max_exhaustive_cpus] [-s steps] [-t spin_us] [-S seed]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_exhaustive < 1 || max_exhaustive > 30 || walk_steps < 1 || spin_us < 0) {
+        fprintf(stderr, "max_exhaustive_cpus must be in [1, 30], steps >= 1 and spin_us >= 0\n");
+        return EXIT_FAILURE;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        return EXIT_FAILURE;
+    }
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &allowed))
+            cpus[ncpus++] = c;
+
+    static char buf[SCHEDSTAT_BUF_SIZE];
+    struct sweep w = { .have_list = 1, .last_cpu = -1 };
+    if (epoch_detector_init(&w.d) == -1 ||
+        schedstat_open(&w.r, getpid(), 0, buf, sizeof(buf)) == -1) {
+        perror("schedstat");
+        return EXIT_FAILURE;
+    }
+    /* Whatever ran before the sweep was within the original affinity. */
+    w.since_reset = allowed;
+
+    char list[256];
+    cpulist_format(&allowed, sizeof(allowed), list, sizeof(list));
+    int exhaustive = ncpus <= max_exhaustive;
+    cpu_set_t set;
+    uint64_t start = bench_now_ns();
+
+    if (exhaustive) {
+        unsigned long long nsubsets = (1ULL << ncpus) - 1;
+        printf("Sweeping all %llu subsets of CPUs %s in Gray-code order\n", nsubsets, list);
+        for (unsigned long long i = 1; i <= nsubsets; i++) {
+            subset_of(i ^ (i >> 1), &set);
+            if (step(&w, &set) == -1)
+                return EXIT_FAILURE;
+        }
+    } else {
+        printf("Random one-CPU-at-a-time walk of %ld steps over the %d CPUs %s (seed %u)\n",
+               walk_steps, ncpus, list, seed);
+        srand(seed);
+        set = allowed;
+        for (long i = 0; i < walk_steps; i++) {
+            int c = cpus[rand() % ncpus];
+            if (CPU_ISSET(c, &set) && CPU_COUNT(&set) > 1)
+                CPU_CLR(c, &set);
+            else
+                CPU_SET(c, &set);
+            if (step(&w, &set) == -1)
+                return EXIT_FAILURE;
+        }
+    }
+    double secs = (bench_now_ns() - start) / 1e9;
+
+    sched_setaffinity(0, sizeof(allowed), &allowed);
+    schedstat_close(&w.r);
+    epoch_detector_destroy(&w.d);
+
+    printf("%ld steps in %.3f s (%.1f us/step), %ld migrations (%.2f per step)\n", w.steps, secs,
+           1e6 * secs / w.steps, w.migrations, (double)w.migrations / w.steps);
+    if (w.have_list)
+        printf("%ld epoch reset(s), %ld failure(s)\n", w.resets, w.failures);
+    else
+        printf("This kernel reports no epoch CPU list: only the running CPU was checked "
+               "(%ld failure(s))\n", w.failures);
+    return w.failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
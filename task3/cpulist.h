@@ -0,0 +1,201 @@
+/* cpulist.h
+
+   Parser and canonical formatter for the epoch CPU list reported in the
+   4th field of the modified /proc/<pid>/schedstat, e.g. "[0-3,8,10-15]".
+
+   Lists are converted to dynamically sized cpu_set_t bitmaps (CPU_ALLOC),
+   so they can be compared as sets (CPU_ISSET_S, CPU_EQUAL_S, cpulist_equal)
+   rather than as strings, on machines with any number of CPUs.
+
+       size_t size;
+       cpu_set_t *set = cpulist_parse_alloc(s.cpu_list, s.cpu_list_len, &size);
+       if (set && CPU_ISSET_S(3, size, set))
+           ...;
+       CPU_FREE(set);
+
+   The formatter writes the same canonical form as the kernel's "%*pbl":
+   ascending, with runs of two or more CPUs collapsed to "a-b".
+
+   Requires _GNU_SOURCE to be defined before any system header is included.
+*/
+
+#ifndef CPULIST_H
+#define CPULIST_H
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+
+/* Largest CPU number accepted (CONFIG_NR_CPUS upper bound on x86-64). */
+#define CPULIST_MAX_CPUS 8192
+
+static inline const char *cpulist_parse_num(const char *p, const char *end, int *out)
+{
+    int v = 0;
+    if (p == end || *p < '0' || *p > '9')
+        return NULL;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        if (v >= CPULIST_MAX_CPUS)
+            return NULL;
+    }
+    *out = v;
+    return p;
+}
+
+/* Walk a list of len bytes, surrounding brackets optional. If set is not
+   NULL every listed CPU is added to it. Stores the highest CPU (-1 for an
+   empty list) in *max. Returns 0, or -1 with errno == EINVAL if malformed
+   and ERANGE if a CPU does not fit in setsize. */
+static inline int cpulist_scan(const char *s, size_t len, cpu_set_t *set, size_t setsize,
+                               int *max)
+{
+    const char *p = s, *end = s + len;
+
+    if (p < end && *p == '[') {
+        if (end[-1] != ']' || len < 2) {
+            errno = EINVAL;
+            return -1;
+        }
+        p++;
+        end--;
+    }
+    *max = -1;
+    while (p < end) {
+        int lo, hi;
+        if (!(p = cpulist_parse_num(p, end, &lo)))
+            goto invalid;
+        hi = lo;
+        if (p < end && *p == '-' && (!(p = cpulist_parse_num(p + 1, end, &hi)) || hi < lo))
+            goto invalid;
+        if (p < end && (*p != ',' || ++p == end))
+            goto invalid;
+
+        if (hi > *max)
+            *max = hi;
+        if (set) {
+            if ((size_t)hi >= setsize * 8) {
+                errno = ERANGE;
+                return -1;
+            }
+            for (int cpu = lo; cpu <= hi; cpu++)
+                CPU_SET_S(cpu, setsize, set);
+        }
+    }
+    return 0;
+
+invalid:
+    errno = EINVAL;
+    return -1;
+}
+
+/* Parse into a caller-provided set of setsize bytes (e.g. from
+   CPU_ALLOC_SIZE), which is cleared first. Returns the number of CPUs in
+   the set, or -1 with errno set as for cpulist_scan(). */
+static inline int cpulist_parse(const char *s, size_t len, cpu_set_t *set, size_t setsize)
+{
+    int max;
+    CPU_ZERO_S(setsize, set);
+    if (cpulist_scan(s, len, set, setsize, &max) == -1)
+        return -1;
+    return CPU_COUNT_S(setsize, set);
+}
+
+/* Parse into a set allocated with CPU_ALLOC, just large enough for the
+   highest CPU listed; its size in bytes is stored in *setsize. Free it
+   with CPU_FREE. Returns NULL with errno set on error. */
+static inline cpu_set_t *cpulist_parse_alloc(const char *s, size_t len, size_t *setsize)
+{
+    int max;
+    if (cpulist_scan(s, len, NULL, 0, &max) == -1)
+        return NULL;
+    int ncpus = max < 0 ? 1 : max + 1;
+    cpu_set_t *set = CPU_ALLOC(ncpus);
+    if (!set) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    *setsize = CPU_ALLOC_SIZE(ncpus);
+    if (cpulist_parse(s, len, set, *setsize) == -1) {
+        CPU_FREE(set);
+        return NULL;
+    }
+    return set;
+}
+
+static inline void cpulist_put(char *buf, size_t buflen, size_t *out, char c)
+{
+    if (*out + 1 < buflen)
+        buf[*out] = c;
+    (*out)++;
+}
+
+static inline void cpulist_put_num(char *buf, size_t buflen, size_t *out, size_t v)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n > 0)
+        cpulist_put(buf, buflen, out, digits[--n]);
+}
+
+/* Write the canonical bracketed form of set, e.g. "[0-3,8]", to buf.
+   Like snprintf(), returns the length the full list needs (excluding the
+   terminator), truncating if that does not fit in buflen. */
+static inline size_t cpulist_format(const cpu_set_t *set, size_t setsize,
+                                    char *buf, size_t buflen)
+{
+    const unsigned long *bits = (const unsigned long *)set;
+    const size_t word_bits = 8 * sizeof(*bits);
+    size_t nbits = setsize * 8, out = 0;
+
+    cpulist_put(buf, buflen, &out, '[');
+    for (size_t cpu = 0; cpu < nbits; cpu++) {
+        /* Skip empty words: sparse sets on large machines are common. */
+        if (cpu % word_bits == 0 && !bits[cpu / word_bits]) {
+            cpu += word_bits - 1;
+            continue;
+        }
+        if (!CPU_ISSET_S(cpu, setsize, set))
+            continue;
+        size_t last = cpu;
+        while (last + 1 < nbits && CPU_ISSET_S(last + 1, setsize, set))
+            last++;
+        if (out > 1)
+            cpulist_put(buf, buflen, &out, ',');
+        cpulist_put_num(buf, buflen, &out, cpu);
+        if (last != cpu) {
+            cpulist_put(buf, buflen, &out, '-');
+            cpulist_put_num(buf, buflen, &out, last);
+        }
+        cpu = last;
+    }
+    cpulist_put(buf, buflen, &out, ']');
+    if (buflen)
+        buf[out < buflen ? out : buflen - 1] = '\0';
+    return out;
+}
+
+/* Set equality for sets of possibly different sizes: bytes beyond the
+   smaller set must be zero in the larger one. */
+static inline int cpulist_equal(const cpu_set_t *a, size_t asize,
+                                const cpu_set_t *b, size_t bsize)
+{
+    const unsigned char *pa = (const unsigned char *)a, *pb = (const unsigned char *)b;
+    size_t common = asize < bsize ? asize : bsize;
+
+    if (memcmp(pa, pb, common) != 0)
+        return 0;
+    for (size_t i = common; i < asize; i++)
+        if (pa[i])
+            return 0;
+    for (size_t i = common; i < bsize; i++)
+        if (pb[i])
+            return 0;
+    return 1;
+}
+
+#endif /* CPULIST_H */
@@ -0,0 +1,202 @@
+/* cpulist_tests.c
+
+   Tests for the epoch CPU-list parser and formatter in cpulist.h: valid and
+   malformed lists, canonical round trips, set comparison across set sizes,
+   and parse/format cost on an 8192-CPU list.
+
+   Compile with:
+       gcc -O2 -Wall -o cpulist_tests cpulist_tests.c
+
+   Usage:
+       ./cpulist_tests
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "cpulist.h"
+
+static int tests_failed = 0;
+
+void check_test(const char *description, long expected, long actual) {
+    if (actual == expected) {
+        printf("[PASS] %s\n", description);
+    } else {
+        printf("[FAIL] %s: expected %ld, got %ld\n", description, expected, actual);
+        tests_failed++;
+    }
+}
+
+void check_test_errno(const char *description, int expected_errno, long ret) {
+    if (ret == -1 && errno == expected_errno) {
+        printf("[PASS] %s: got -1 and errno set to %d as expected.\n", description, expected_errno);
+    } else {
+        printf("[FAIL] %s: expected -1 with errno %d, got %ld with errno %d\n", description, expected_errno, ret, errno);
+        tests_failed++;
+    }
+}
+
+void check_test_str(const char *description, const char *expected, const char *actual) {
+    if (strcmp(expected, actual) == 0) {
+        printf("[PASS] %s\n", description);
+    } else {
+        printf("[FAIL] %s: expected \"%s\", got \"%s\"\n", description, expected, actual);
+        tests_failed++;
+    }
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Parse `in` and check that it formats back to `canonical`. */
+static void check_round_trip(const char *in, const char *canonical, int count) {
+    char desc[128], out[256];
+    size_t setsize;
+    cpu_set_t *set = cpulist_parse_alloc(in, strlen(in), &setsize);
+
+    snprintf(desc, sizeof(desc), "Parse %s", in);
+    check_test(desc, 1, set != NULL);
+    if (!set)
+        return;
+    snprintf(desc, sizeof(desc), "Parse %s: CPU count", in);
+    check_test(desc, count, CPU_COUNT_S(setsize, set));
+    cpulist_format(set, setsize, out, sizeof(out));
+    snprintf(desc, sizeof(desc), "Format %s", in);
+    check_test_str(desc, canonical, out);
+    CPU_FREE(set);
+}
+
+void test_valid_lists(void) {
+    printf("Running valid list tests...\n");
+    check_round_trip("[]", "[]", 0);
+    check_round_trip("[0]", "[0]", 1);
+    check_round_trip("[0-1]", "[0-1]", 2);
+    check_round_trip("[0-3,8,10-15]", "[0-3,8,10-15]", 11);
+    check_round_trip("0,2", "[0,2]", 2);
+    /* Not canonical: out of order, overlapping and adjacent pieces. */
+    check_round_trip("[3,1,2,2]", "[1-3]", 3);
+    check_round_trip("[0-4,2-6,7]", "[0-7]", 8);
+    check_round_trip("[5-5]", "[5]", 1);
+    check_round_trip("[63,64]", "[63-64]", 2);
+    check_round_trip("[8191]", "[8191]", 1);
+}
+
+void test_malformed_lists(void) {
+    static const char *bad[] = {
+        "[", "[0", "0]", "[a]", "[1,,2]", "[1,]", "[,1]", "[3-1]",
+        "[1-]", "[-1]", "[1 2]", "[8192]", "[0-99999]",
+    };
+    char desc[64];
+
+    printf("Running malformed list tests...\n");
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        size_t setsize;
+        snprintf(desc, sizeof(desc), "Reject %s", bad[i]);
+        errno = 0;
+        cpu_set_t *set = cpulist_parse_alloc(bad[i], strlen(bad[i]), &setsize);
+        check_test_errno(desc, EINVAL, set ? 0 : -1);
+        if (set)
+            CPU_FREE(set);
+    }
+
+    /* A valid list that does not fit in the caller's set. */
+    size_t setsize = CPU_ALLOC_SIZE(64);
+    cpu_set_t *set = CPU_ALLOC(64);
+    errno = 0;
+    check_test_errno("CPU beyond caller's set size", ERANGE,
+                     cpulist_parse("[0,4000]", 8, set, setsize));
+    CPU_FREE(set);
+}
+
+void test_set_comparison(void) {
+    size_t asize = 0, bsize = 0;
+    cpu_set_t mask;
+
+    printf("Running set comparison tests...\n");
+    cpu_set_t *a = cpulist_parse_alloc("[0-1]", 5, &asize);
+    cpu_set_t *b = cpulist_parse_alloc("[1,0]", 5, &bsize);
+    check_test("Equal sets, different spelling", 1, cpulist_equal(a, asize, b, bsize));
+
+    CPU_ZERO(&mask);
+    CPU_SET(0, &mask);
+    CPU_SET(1, &mask);
+    check_test("Equal to a fixed-size cpu_set_t", 1, cpulist_equal(a, asize, &mask, sizeof(mask)));
+    CPU_SET(1000, &mask);
+    check_test("Differs beyond the smaller set", 0, cpulist_equal(a, asize, &mask, sizeof(mask)));
+    check_test("Membership: CPU 1", 1, CPU_ISSET_S(1, asize, a) != 0);
+    check_test("Membership: CPU 3", 0, CPU_ISSET_S(3, asize, a) != 0);
+    CPU_FREE(a);
+    CPU_FREE(b);
+}
+
+/* Build "[0,2,4,...,8190]", the worst case for both the parser and the
+   formatter, and a random set; time parsing and check the round trip. */
+void test_large_lists(void) {
+    static char list[65536], out[65536];
+    size_t setsize = CPU_ALLOC_SIZE(CPULIST_MAX_CPUS);
+    cpu_set_t *set = CPU_ALLOC(CPULIST_MAX_CPUS);
+    size_t len = 0;
+    const int rounds = 1000;
+
+    printf("Running %d-CPU list tests...\n", CPULIST_MAX_CPUS);
+    len += snprintf(list + len, sizeof(list) - len, "[");
+    for (int cpu = 0; cpu < CPULIST_MAX_CPUS; cpu += 2)
+        len += snprintf(list + len, sizeof(list) - len, "%s%d", cpu ? "," : "", cpu);
+    len += snprintf(list + len, sizeof(list) - len, "]");
+
+    double start = now_us();
+    for (int i = 0; i < rounds; i++)
+        cpulist_parse(list, len, set, setsize);
+    double parse_us = (now_us() - start) / rounds;
+
+    check_test("Parse every other CPU of 8192", CPULIST_MAX_CPUS / 2,
+               cpulist_parse(list, len, set, setsize));
+    start = now_us();
+    for (int i = 0; i < rounds; i++)
+        cpulist_format(set, setsize, out, sizeof(out));
+    double format_us = (now_us() - start) / rounds;
+    check_test_str("Format every other CPU of 8192", list, out);
+    printf("  %zu-byte list: parse %.1f us, format %.1f us\n", len, parse_us, format_us);
+    check_test("Parse takes under a millisecond", 1, parse_us < 1000.0);
+
+    check_test("Parse [0-8191]", CPULIST_MAX_CPUS, cpulist_parse("[0-8191]", 8, set, setsize));
+
+    /* Random sets: parse(format(set)) must give the set back. */
+    size_t rsize;
+    int mismatches = 0;
+    srand(1);
+    for (int i = 0; i < 100; i++) {
+        CPU_ZERO_S(setsize, set);
+        for (int cpu = 0; cpu < CPULIST_MAX_CPUS; cpu++)
+            if (rand() % 4 == 0)
+                CPU_SET_S(cpu, setsize, set);
+        size_t n = cpulist_format(set, setsize, out, sizeof(out));
+        cpu_set_t *back = cpulist_parse_alloc(out, n, &rsize);
+        if (!back || !cpulist_equal(set, setsize, back, rsize))
+            mismatches++;
+        if (back)
+            CPU_FREE(back);
+    }
+    check_test("Random 8192-CPU sets round trip", 0, mismatches);
+    CPU_FREE(set);
+}
+
+int main(void) {
+    printf("Running CPU list tests (Task 3)...\n");
+    test_valid_lists();
+    test_malformed_lists();
+    test_set_comparison();
+    test_large_lists();
+
+    if (tests_failed == 0)
+        printf("All tests passed.\n");
+    else
+        printf("%d test(s) failed.\n", tests_failed);
+    return tests_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,303 @@
+/* ctxswitch_bench.c
+
+   Context-switch microbenchmark, to price the extra work the epoch CPU
+   tracking of the modified /proc/<pid>/schedstat adds to every switch and
+   migration.
+
+   Two processes, each pinned, hand control back and forth:
+
+     pipe    ping-pong over a pair of pipes (read/write wakeups);
+     futex   ping-pong on a shared word with FUTEX_WAIT/FUTEX_WAKE;
+     yield   both call sched_yield() in a tight loop (same CPU only; a
+             single yielder is also timed as the no-switch baseline).
+
+   The ping-pongs run with both processes on the same CPU, where every
+   hand-off is a switch, and on two different CPUs, where every hand-off is
+   a cross-CPU wakeup. For each case the report gives the p50 over
+   `repeats` runs of the time per hand-off (ns) and hand-offs per second,
+   and the switches the two processes actually went through per hand-off,
+   counted with getrusage() and with the timeslices field of their
+   schedstat. Only standard interfaces are used, so the numbers from a
+   stock kernel and from the modified one can be compared directly; the
+   header line says which one it is.
+
+   Compile with:
+       gcc -O2 -Wall -o ctxswitch_bench ctxswitch_bench.c
+
+   Usage:
+       ./ctxswitch_bench [-i iterations] [-r repeats] [-a cpu] [-b cpu]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include "../common/bench.h"
+#include "../common/latch.h"
+#include "schedstat_reader.h"
+
+static long iterations = 100000;
+static int repeats = 5;
+static int cpu_a = -1, cpu_b = -1;
+
+enum { MODE_PIPE, MODE_FUTEX, MODE_YIELD, MODE_YIELD_ALONE };
+static const char *mode_names[] = { "pipe", "futex", "yield", "yield(1)" };
+
+/* Shared between the parent and the two tasks of a run. */
+struct run {
+    struct latch *latch;
+    atomic_int turn;            /* futex ping-pong: whose move it is */
+    uint64_t elapsed_ns[2];     /* per task, from go to the end of its loop */
+    uint64_t switches[2];       /* voluntary + involuntary, from getrusage() */
+    uint64_t timeslices[2];     /* from the task's schedstat */
+    int failed;
+};
+
+static int pipes[2][2];         /* [0]: a -> b, [1]: b -> a */
+
+static uint64_t count_switches(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+static uint64_t count_timeslices(void) {
+    char buf[SCHEDSTAT_BUF_SIZE];
+    struct schedstat_reader r;
+    struct schedstat_sample s;
+    if (schedstat_open(&r, getpid(), 0, buf, sizeof(buf)) == -1)
+        return 0;
+    int ret = schedstat_read(&r, &s);
+    schedstat_close(&r);
+    return ret == 0 ? s.timeslices : 0;
+}
+
+static void futex_wait(atomic_int *word, int val) {
+    syscall(SYS_futex, word, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_int *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* Body of task `self` (0 starts every exchange) in one run. */
+static void run_task(struct run *run, int mode, int self, int cpu) {
+    char byte = 0;
+
+    if (bench_pin_cpu(cpu) == -1) {
+        run->failed = 1;
+        _exit(EXIT_FAILURE);
+    }
+    if (mode == MODE_PIPE) {
+        close(pipes[0][self]);          /* a keeps [0] write and [1] read */
+        close(pipes[1][!self]);
+    }
+    latch_arrive(run->latch);
+    latch_wait_go(run->latch);
+
+    uint64_t sw = count_switches(), ts = count_timeslices();
+    uint64_t t0 = bench_now_ns();
+    for (long i = 0; i < iterations; i++) {
+        switch (mode) {
+        case MODE_PIPE:
+            if (self == 0) {
+                if (write(pipes[0][1], &byte, 1) != 1 || read(pipes[1][0], &byte, 1) != 1)
+                    run->failed = 1;
+            } else {
+                if (read(pipes[0][0], &byte, 1) != 1 || write(pipes[1][1], &byte, 1) != 1)
+                    run->failed = 1;
+            }
+            break;
+        case MODE_FUTEX:
+            while (atomic_load(&run->turn) != self)
+                futex_wait(&run->turn, !self);
+            atomic_store(&run->turn, !self);
+            futex_wake(&run->turn);
+            break;
+        default:
+            sched_yield();
+            break;
+        }
+    }
+    run->elapsed_ns[self] = bench_now_ns() - t0;
+    run->switches[self] = count_switches() - sw;
+    run->timeslices[self] = count_timeslices() - ts;
+    _exit(run->failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* One run: returns the time per hand-off in ns (0 on failure) and adds
+   the switches both tasks saw to *switches and *timeslices. */
+static double run_once(struct run *run, int mode, int cpu0, int cpu1,
+                       uint64_t *switches, uint64_t *timeslices) {
+    int ntasks = mode == MODE_YIELD_ALONE ? 1 : 2;
+    pid_t pids[2];
+
+    memset(run, 0, sizeof(*run));
+    run->latch = latch_create();
+    if (!run->latch || (mode == MODE_PIPE && (pipe(pipes[0]) == -1 || pipe(pipes[1]) == -1))) {
+        perror("latch_create/pipe");
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
+    for (int t = 0; t < ntasks; t++) {
+        pids[t] = fork();
+        if (pids[t] < 0) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pids[t] == 0)
+            run_task(run, mode, t, t == 0 ? cpu0 : cpu1);
+    }
+    if (mode == MODE_PIPE)
+        for (int i = 0; i < 2; i++) {
+            close(pipes[i][0]);
+            close(pipes[i][1]);
+        }
+    /* If a task never arrived (e.g. it could not be pinned), the other
+       one would wait for its partner forever: kill both. */
+    int ready = latch_wait_ready(run->latch, ntasks);
+    if (ready != 0)
+        for (int t = 0; t < ntasks; t++)
+            kill(pids[t], SIGKILL);
+    latch_release(run->latch);
+
+    int ok = ready == 0;
+    for (int t = 0; t < ntasks; t++) {
+        int status;
+        waitpid(pids[t], &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    latch_destroy(run->latch);
+    if (!ok)
+        return 0;
+
+    /* Ping-pong: a round trip is two hand-offs. Yield: every yield of
+       either task is a hand-off; the run lasts as long as the slower task. */
+    uint64_t elapsed = run->elapsed_ns[0];
+    double handoffs = 2.0 * iterations;
+    if (mode == MODE_YIELD || mode == MODE_YIELD_ALONE) {
+        elapsed = run->elapsed_ns[0] > run->elapsed_ns[1] ? run->elapsed_ns[0] : run->elapsed_ns[1];
+        handoffs = (double)ntasks * iterations;
+    }
+    for (int t = 0; t < ntasks; t++) {
+        *switches += run->switches[t];
+        *timeslices += run->timeslices[t];
+    }
+    return elapsed / handoffs;
+}
+
+static int bench_case(struct run *run, int mode, int cpu0, int cpu1) {
+    uint64_t per[repeats], switches = 0, timeslices = 0;
+    int ntasks = mode == MODE_YIELD_ALONE ? 1 : 2;
+
+    for (int r = 0; r < repeats; r++) {
+        double ns = run_once(run, mode, cpu0, cpu1, &switches, &timeslices);
+        if (ns == 0) {
+            fprintf(stderr, "%s on CPUs %d/%d failed\n", mode_names[mode], cpu0, cpu1);
+            return 1;
+        }
+        per[r] = (uint64_t)(ns * 1000);   /* ps, to keep the fraction */
+    }
+    struct bench_summary s;
+    bench_summarize(per, repeats, &s);
+
+    double handoffs = (double)repeats * iterations * (mode < MODE_YIELD ? 2 : ntasks);
+    char cpus[32];
+    if (ntasks == 1)
+        snprintf(cpus, sizeof(cpus), "%d", cpu0);
+    else
+        snprintf(cpus, sizeof(cpus), "%d,%d", cpu0, cpu1);
+    printf("%-9s %-9s %12.1f %12.1f %14.0f %10.2f %10.2f\n", mode_names[mode], cpus,
+           s.p50 / 1000.0, s.min / 1000.0, 1e12 / s.p50, switches / handoffs,
+           timeslices / handoffs);
+    bench_metric(s.p50 / 1000.0, "ctxswitch.%s.%s.handoff_ns", mode_names[mode],
+                 ntasks == 1 ? "alone" : cpu0 == cpu1 ? "same_cpu" : "cross_cpu");
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "i:r:a:b:")) != -1) {
+        switch (opt) {
+        case 'i': iterations = atol(optarg); break;
+        case 'r': repeats = atoi(optarg); break;
+        case 'a': cpu_a = atoi(optarg); break;
+        case 'b': cpu_b = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-i iterations] [-r repeats] [-a cpu] [-b cpu]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (iterations < 1 || repeats < 1) {
+        fprintf(stderr, "iterations and repeats must be >= 1\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Default to the first two CPUs we may run on. */
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        return EXIT_FAILURE;
+    }
+    if ((cpu_a >= 0 && (cpu_a >= CPU_SETSIZE || !CPU_ISSET(cpu_a, &allowed))) ||
+        (cpu_b >= 0 && (cpu_b >= CPU_SETSIZE || !CPU_ISSET(cpu_b, &allowed)))) {
+        fprintf(stderr, "-a and -b must be CPUs this process may run on\n");
+        return EXIT_FAILURE;
+    }
+    for (int c = 0; c < CPU_SETSIZE && (cpu_a < 0 || cpu_b < 0); c++) {
+        if (!CPU_ISSET(c, &allowed) || c == cpu_a || c == cpu_b)
+            continue;
+        if (cpu_a < 0)
+            cpu_a = c;
+        else
+            cpu_b = c;
+    }
+
+    /* Say which kernel this is, so stock and modified runs can be told
+       apart: the modified one has the bracketed CPU list. */
+    char buf[SCHEDSTAT_BUF_SIZE];
+    struct schedstat_reader r;
+    struct schedstat_sample s = { 0 };
+    struct utsname u;
+    uname(&u);
+    if (schedstat_open(&r, getpid(), 0, buf, sizeof(buf)) == 0) {
+        schedstat_read(&r, &s);
+        schedstat_close(&r);
+    }
+    printf("Kernel %s, epoch CPU tracking %s; %ld hand-offs x %d runs per case\n", u.release,
+           s.cpu_list ? "present" : "absent (stock)", iterations, repeats);
+
+    struct run *run = mmap(NULL, sizeof(*run), PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (run == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    int failures = 0;
+    printf("%-9s %-9s %12s %12s %14s %10s %10s\n", "mode", "cpus", "p50(ns)", "min(ns)",
+           "handoffs/s", "csw/hoff", "slices/hoff");
+    failures += bench_case(run, MODE_YIELD_ALONE, cpu_a, cpu_a);
+    failures += bench_case(run, MODE_YIELD, cpu_a, cpu_a);
+    failures += bench_case(run, MODE_PIPE, cpu_a, cpu_a);
+    failures += bench_case(run, MODE_FUTEX, cpu_a, cpu_a);
+    if (cpu_b >= 0) {
+        failures += bench_case(run, MODE_PIPE, cpu_a, cpu_b);
+        failures += bench_case(run, MODE_FUTEX, cpu_a, cpu_b);
+    } else {
+        printf("(cross-CPU cases skipped: only one CPU allowed)\n");
+    }
+    munmap(run, sizeof(*run));
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
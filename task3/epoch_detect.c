@@ -0,0 +1,216 @@
+/* epoch_detect.c
+
+   Measures when the epoch CPU list in /proc/<pid>/schedstat rolls over.
+
+   A CPU-bound child moves to the next allowed CPU every `hop` ms, so its
+   CPU list grows to every allowed CPU within an epoch. Meanwhile the parent
+   samples the child's schedstat at a fixed rate (1 kHz by default) with
+   absolute clock_nanosleep() deadlines and epoch_detect.h, and finds the
+   exact samples at which the list is reset. For every reset it reports the
+   wall time since the child started and the child's exec_time, each with
+   the window between that sample and the previous one (the uncertainty),
+   plus the time since the previous reset.
+
+   Once `resets` rollovers have been seen, it summarizes the intervals
+   between them in both wall and on-CPU time (mean, standard deviation,
+   min, max, and how far the mean is from the nominal epoch length): the
+   clock the kernel counts epochs in is the one with the steady interval,
+   and the deviation shows how late the rollover is. The measurement is
+   bounded: without a reset for 2 nominal epochs it gives up and fails.
+
+   With a single allowed CPU the list can only reset by becoming empty, and
+   on kernels without the CPU list nothing can be detected at all.
+
+   Compile with:
+       gcc -O2 -Wall -o epoch_detect epoch_detect.c -lm
+
+   Usage:
+       ./epoch_detect [-n resets] [-f hz] [-h hop_ms] [-e epoch_s]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "../common/bench.h"
+#include "epoch_detect.h"
+
+static int resets_wanted = 3;
+static long hz = 1000;
+static long hop_ms = 10;
+static double epoch_s = 10.0;
+
+/* Child: hop across the allowed CPUs forever, spinning in between. */
+static void run_worker(void) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        _exit(EXIT_FAILURE);
+    }
+    int cpu = -1;
+    volatile unsigned long dummy = 0;
+    for (;;) {
+        if (CPU_COUNT(&allowed) > 1 && (cpu = epoch_hop(&allowed, sizeof(allowed), cpu)) == -1) {
+            perror("sched_setaffinity");
+            _exit(EXIT_FAILURE);
+        }
+        uint64_t until = bench_now_ns() + (uint64_t)hop_ms * 1000000;
+        while (bench_now_ns() < until)
+            dummy++;
+    }
+}
+
+static void summarize(const char *clock, const double *v, int n) {
+    double sum = 0, sq = 0, min = v[0], max = v[0];
+    for (int i = 0; i < n; i++) {
+        sum += v[i];
+        min = v[i] < min ? v[i] : min;
+        max = v[i] > max ? v[i] : max;
+    }
+    double mean = sum / n;
+    for (int i = 0; i < n; i++)
+        sq += (v[i] - mean) * (v[i] - mean);
+    printf("  %-5s mean %9.4f s  stddev %8.4f s  min %9.4f s  max %9.4f s  mean-epoch %+8.4f s\n",
+           clock, mean, n > 1 ? sqrt(sq / (n - 1)) : 0.0, min, max, mean - epoch_s);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:h:e:")) != -1) {
+        switch (opt) {
+        case 'n': resets_wanted = atoi(optarg); break;
+        case 'f': hz = atol(optarg); break;
+        case 'h': hop_ms = atol(optarg); break;
+        case 'e': epoch_s = atof(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n resets] [-f hz] [-h hop_ms] [-e epoch_s]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (resets_wanted < 1 || hz < 1 || hop_ms < 1 || epoch_s <= 0) {
+        fprintf(stderr, "resets, hz, hop_ms and epoch_s must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    struct epoch_detector d;
+    if (epoch_detector_init(&d) == -1) {
+        perror("epoch_detector_init");
+        return EXIT_FAILURE;
+    }
+    double *wall = calloc(resets_wanted, sizeof(*wall));
+    double *exec = calloc(resets_wanted, sizeof(*exec));
+    if (!wall || !exec) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    fflush(stdout);
+    uint64_t start = bench_now_ns();
+    pid_t worker = fork();
+    if (worker < 0) {
+        perror("fork");
+        return EXIT_FAILURE;
+    }
+    if (worker == 0)
+        run_worker();
+
+    static char buf[SCHEDSTAT_BUF_SIZE];
+    struct schedstat_reader r;
+    if (schedstat_open(&r, worker, 0, buf, sizeof(buf)) == -1) {
+        perror("open schedstat");
+        kill(worker, SIGKILL);
+        waitpid(worker, NULL, 0);
+        return EXIT_FAILURE;
+    }
+
+    printf("Sampling PID %d at %ld Hz, hopping CPUs every %ld ms, nominal epoch %.1f s\n",
+           worker, hz, hop_ms, epoch_s);
+    printf("%5s %12s %10s %12s %10s %12s %12s\n", "reset", "wall(s)", "+-(ms)", "exec(s)",
+           "+-(ms)", "dwall(s)", "dexec(s)");
+
+    uint64_t period = 1000000000ULL / hz;
+    uint64_t limit = (uint64_t)(2 * epoch_s * 1e9);
+    uint64_t last_reset = start;
+    long missed = 0, samples = 0;
+    int found = 0, status = EXIT_SUCCESS;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (found < resets_wanted) {
+        struct schedstat_sample s;
+        struct epoch_reset reset;
+        uint64_t now = bench_now_ns();
+        if (schedstat_read(&r, &s) == -1) {
+            perror("read schedstat");
+            status = EXIT_FAILURE;
+            break;
+        }
+        samples++;
+        int ret = epoch_detector_feed(&d, &s, now, &reset);
+        if (ret == -1) {
+            if (errno == ENOTSUP)
+                fprintf(stderr, "This kernel reports no epoch CPU list in schedstat\n");
+            else
+                perror("parse CPU list");
+            status = EXIT_FAILURE;
+            break;
+        }
+        if (ret == 1) {
+            wall[found] = (reset.wall_ns - start) / 1e9;
+            exec[found] = reset.exec_time / 1e9;
+            printf("%5d %12.6f %10.3f %12.6f %10.3f %12.6f %12.6f\n", found + 1, wall[found],
+                   reset.wall_window_ns / 1e6, exec[found], reset.exec_window / 1e6,
+                   found ? wall[found] - wall[found - 1] : wall[found],
+                   found ? exec[found] - exec[found - 1] : exec[found]);
+            fflush(stdout);
+            found++;
+            last_reset = now;
+        } else if (now - last_reset > limit) {
+            fprintf(stderr, "No epoch reset within %.1f s (%ld samples, CPU list %.*s)\n",
+                    limit / 1e9, samples, (int)s.cpu_list_len, s.cpu_list);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        next.tv_nsec += period;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (ts.tv_sec > next.tv_sec || (ts.tv_sec == next.tv_sec && ts.tv_nsec > next.tv_nsec)) {
+            missed++;
+            next = ts;
+        } else {
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+
+    kill(worker, SIGKILL);
+    waitpid(worker, NULL, 0);
+    schedstat_close(&r);
+    epoch_detector_destroy(&d);
+
+    printf("%ld samples, %ld missed deadlines\n", samples, missed);
+    if (found > 1) {
+        /* Intervals between consecutive resets; the first reset only gives
+           the phase of the epoch at fork time. */
+        for (int i = 0; i < found - 1; i++) {
+            wall[i] = wall[i + 1] - wall[i];
+            exec[i] = exec[i + 1] - exec[i];
+        }
+        printf("Intervals between %d resets:\n", found);
+        summarize("wall", wall, found - 1);
+        summarize("exec", exec, found - 1);
+    }
+    free(wall);
+    free(exec);
+    return status;
+}
@@ -0,0 +1,129 @@
+/* epoch_detect.h
+
+   Finds the epoch rollovers of the schedstat CPU list in a stream of
+   samples of one task.
+
+   Within an epoch the list only grows: every CPU the task runs on is
+   added to it. At a rollover it starts over from the CPU the task is on
+   (or from nothing), so the first sample whose CPU set is not a superset
+   of the previous sample's is the first sample of a new epoch. A task that
+   never leaves its CPU shows no such change, so the sampled task should
+   move between CPUs (epoch_hop()) many times per epoch. The reset is
+   only known to lie between two consecutive samples; the detector reports
+   that window, so the sampling rate bounds the error.
+
+       struct epoch_detector d;
+       struct epoch_reset reset;
+       epoch_detector_init(&d);
+       for (each sample s taken at time now)
+           if (epoch_detector_feed(&d, &s, now, &reset) == 1)
+               ... reset.exec_time, reset.wall_ns ...;
+       epoch_detector_destroy(&d);
+
+   Requires _GNU_SOURCE to be defined before any system header is included.
+*/
+
+#ifndef EPOCH_DETECT_H
+#define EPOCH_DETECT_H
+
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include "cpulist.h"
+#include "schedstat_reader.h"
+
+struct epoch_reset {
+    uint64_t wall_ns;               /* time of the first sample of the new epoch */
+    unsigned long long exec_time;   /* the task's exec_time in that sample (ns) */
+    uint64_t wall_window_ns;        /* time since the previous sample */
+    unsigned long long exec_window; /* exec_time since the previous sample (ns) */
+};
+
+struct epoch_detector {
+    cpu_set_t *prev, *cur;
+    size_t setsize;
+    int primed;                     /* prev holds a sample */
+    uint64_t prev_wall;
+    unsigned long long prev_exec;
+};
+
+/* Returns 0, or -1 with errno == ENOMEM. */
+static inline int epoch_detector_init(struct epoch_detector *d)
+{
+    d->setsize = CPU_ALLOC_SIZE(CPULIST_MAX_CPUS);
+    d->prev = CPU_ALLOC(CPULIST_MAX_CPUS);
+    d->cur = CPU_ALLOC(CPULIST_MAX_CPUS);
+    d->primed = 0;
+    d->prev_wall = 0;
+    d->prev_exec = 0;
+    if (!d->prev || !d->cur) {
+        CPU_FREE(d->prev);
+        CPU_FREE(d->cur);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+static inline void epoch_detector_destroy(struct epoch_detector *d)
+{
+    CPU_FREE(d->prev);
+    CPU_FREE(d->cur);
+    d->prev = d->cur = NULL;
+}
+
+/* Feed one sample, taken at wall_ns. Returns 1 and fills in *reset if the
+   CPU list lost a CPU since the previous sample, 0 if not, or -1 with errno
+   == ENOTSUP if the kernel reports no CPU list, EINVAL if it is malformed. */
+static inline int epoch_detector_feed(struct epoch_detector *d, const struct schedstat_sample *s,
+                                      uint64_t wall_ns, struct epoch_reset *reset)
+{
+    if (!s->cpu_list) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    if (cpulist_parse(s->cpu_list, s->cpu_list_len, d->cur, d->setsize) == -1)
+        return -1;
+
+    int lost = 0;
+    if (d->primed) {
+        const unsigned char *p = (const unsigned char *)d->prev, *c = (const unsigned char *)d->cur;
+        for (size_t i = 0; i < d->setsize && !lost; i++)
+            lost = (p[i] & ~c[i]) != 0;
+    }
+    if (lost) {
+        reset->wall_ns = wall_ns;
+        reset->exec_time = s->exec_time;
+        reset->wall_window_ns = wall_ns - d->prev_wall;
+        reset->exec_window = s->exec_time - d->prev_exec;
+    }
+
+    cpu_set_t *t = d->prev;
+    d->prev = d->cur;
+    d->cur = t;
+    d->prev_wall = wall_ns;
+    d->prev_exec = s->exec_time;
+    d->primed = 1;
+    return lost;
+}
+
+/* Move the calling thread to the next CPU of `allowed` after `cpu` (the
+   first one for -1), wrapping around. Returns the new CPU, or -1 with errno
+   set if the affinity cannot be changed. */
+static inline int epoch_hop(const cpu_set_t *allowed, size_t setsize, int cpu)
+{
+    int ncpus = (int)setsize * 8;
+    for (int i = 1; i <= ncpus; i++) {
+        int next = (cpu + i + ncpus) % ncpus;
+        if (!CPU_ISSET_S(next, setsize, allowed))
+            continue;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(next, &mask);
+        return sched_setaffinity(0, sizeof(mask), &mask) == 0 ? next : -1;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+#endif /* EPOCH_DETECT_H */
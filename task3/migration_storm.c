@@ -0,0 +1,241 @@
+/* migration_storm.c
+
+   Migration-storm benchmark: the compiled, full-speed version of the
+   affinity loop in runtask.sh (taskset -cp over CPU combinations with
+   2-second sleeps).
+
+   A burner thread spins, noting every CPU it finds itself on
+   (sched_getcpu()), while the main thread moves it round robin across the
+   CPUs of -c (default: every allowed CPU) with sched_setaffinity() as fast
+   as it can, for `seconds` seconds. The report gives:
+
+     - affinity changes per second and the cost of each call (p50/p99/max):
+       moving a running task waits for it to be pushed off its old CPU;
+     - migrations per second, as seen by the burner;
+     - whether the epoch CPU list in the burner's schedstat stays correct
+       under the churn. Every millisecond (-f) the list is sampled and must
+       (1) contain only CPUs of the rotation, once an epoch reset has
+       cleared whatever the burner inherited, and (2) contain every CPU the
+       burner saw itself on since the previous sample, unless the epoch
+       rolled over in between (epoch_detect.h).
+
+   A (2) failure right at a rollover the detector missed (the list grew
+   back past its old contents within one sample) can be a false alarm, so
+   the number of resets seen is reported alongside.
+
+   Compile with:
+       gcc -O2 -Wall -pthread -o migration_storm migration_storm.c
+
+   Usage:
+       ./migration_storm [-d seconds] [-c cpulist] [-f hz]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include "../common/bench.h"
+#include "cpulist.h"
+#include "epoch_detect.h"
+
+#define MAX_LATENCY_SAMPLES (1 << 22)
+#define SEEN_WORDS (CPU_SETSIZE / 64)
+
+static double seconds = 5.0;
+static const char *cpu_spec = NULL;
+static long hz = 1000;
+
+static atomic_int stop;
+static atomic_int burner_tid;
+static atomic_long migrations;
+/* CPUs the burner has run on since the sampler last looked. */
+static atomic_ulong seen[SEEN_WORDS];
+
+static void *burner(void *arg) {
+    int last = -1;
+    (void)arg;
+    atomic_store(&burner_tid, syscall(SYS_gettid));
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        int cpu = sched_getcpu();
+        if (cpu == last || cpu < 0 || cpu >= CPU_SETSIZE)
+            continue;
+        if (last >= 0)
+            atomic_fetch_add_explicit(&migrations, 1, memory_order_relaxed);
+        atomic_fetch_or_explicit(&seen[cpu / 64], 1UL << (cpu % 64), memory_order_relaxed);
+        last = cpu;
+    }
+    return NULL;
+}
+
+struct checks {
+    long samples, resets, outside, missing;
+    int have_list;
+};
+
+/* Sample the burner's CPU list and check it against the rotation and
+   against what the burner saw since the last sample. */
+static void check_list(struct schedstat_reader *r, struct epoch_detector *d,
+                       const cpu_set_t *rotation, size_t rotsize, struct checks *c) {
+    struct schedstat_sample s;
+    struct epoch_reset reset;
+    unsigned long saw[SEEN_WORDS];
+    char list[256];
+
+    /* Collect first: every CPU in saw was run on before the read below. */
+    for (int w = 0; w < SEEN_WORDS; w++)
+        saw[w] = atomic_exchange_explicit(&seen[w], 0, memory_order_relaxed);
+    uint64_t now = bench_now_ns();
+    if (schedstat_read(r, &s) == -1)
+        return;
+    int ret = epoch_detector_feed(d, &s, now, &reset);
+    if (ret == -1) {
+        c->have_list = 0;
+        return;
+    }
+    c->samples++;
+    if (ret == 1) {
+        c->resets++;
+        return;
+    }
+
+    const cpu_set_t *set = d->prev;     /* the sample just fed */
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        int listed = CPU_ISSET_S(cpu, d->setsize, set);
+        if (listed && c->resets > 0 && !CPU_ISSET_S(cpu, rotsize, rotation)) {
+            if (c->outside++ == 0)
+                printf("[FAIL] CPU list %.*s has CPU %d outside the rotation\n",
+                       (int)s.cpu_list_len, s.cpu_list, cpu);
+        }
+        if (!listed && (saw[cpu / 64] >> (cpu % 64) & 1)) {
+            if (c->missing++ == 0) {
+                cpulist_format(set, d->setsize, list, sizeof(list));
+                printf("[FAIL] CPU list %s misses CPU %d the burner ran on\n", list, cpu);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:c:f:")) != -1) {
+        switch (opt) {
+        case 'd': seconds = atof(optarg); break;
+        case 'c': cpu_spec = optarg; break;
+        case 'f': hz = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d seconds] [-c cpulist] [-f hz]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (seconds <= 0 || hz < 1) {
+        fprintf(stderr, "seconds and hz must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    /* The rotation: CPUs of -c, or every CPU we may run on. */
+    cpu_set_t rotation;
+    int cpus[CPU_SETSIZE], ncpus = 0;
+    if (sched_getaffinity(0, sizeof(rotation), &rotation) == -1) {
+        perror("sched_getaffinity");
+        return EXIT_FAILURE;
+    }
+    if (cpu_spec && cpulist_parse(cpu_spec, strlen(cpu_spec), &rotation, sizeof(rotation)) < 1) {
+        fprintf(stderr, "bad CPU list \"%s\": expected e.g. 0-3,8\n", cpu_spec);
+        return EXIT_FAILURE;
+    }
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &rotation))
+            cpus[ncpus++] = c;
+
+    uint64_t *lat = malloc(MAX_LATENCY_SAMPLES * sizeof(*lat));
+    struct epoch_detector d;
+    if (!lat || epoch_detector_init(&d) == -1) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(rotation), &rotation);
+    if (pthread_create(&thread, &attr, burner, NULL) != 0) {
+        perror("pthread_create");
+        return EXIT_FAILURE;
+    }
+    pthread_attr_destroy(&attr);
+    while (atomic_load(&burner_tid) == 0)
+        sched_yield();
+    pid_t tid = atomic_load(&burner_tid);
+
+    static char buf[SCHEDSTAT_BUF_SIZE];
+    struct schedstat_reader r;
+    if (schedstat_open(&r, getpid(), tid, buf, sizeof(buf)) == -1) {
+        perror("open schedstat");
+        return EXIT_FAILURE;
+    }
+
+    char list[256];
+    cpulist_format(&rotation, sizeof(rotation), list, sizeof(list));
+    printf("Moving burner %d round robin over CPUs %s for %.1f s\n", tid, list, seconds);
+    if (ncpus == 1)
+        printf("(one CPU in the rotation: the affinity calls cannot migrate anything)\n");
+
+    struct checks checks = { .have_list = 1 };
+    uint64_t period = 1000000000ULL / hz;
+    uint64_t start = bench_now_ns(), end = start + (uint64_t)(seconds * 1e9);
+    uint64_t next_check = start, now = start;
+    long calls = 0, errors = 0, taken = 0;
+    long migrations_before = atomic_load(&migrations);
+
+    while (now < end) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpus[calls % ncpus], &mask);
+        uint64_t t0 = bench_now_ns();
+        if (sched_setaffinity(tid, sizeof(mask), &mask) == -1)
+            errors++;
+        now = bench_now_ns();
+        if (taken < MAX_LATENCY_SAMPLES)
+            lat[taken++] = now - t0;
+        calls++;
+        if (checks.have_list && now >= next_check) {
+            check_list(&r, &d, &rotation, sizeof(rotation), &checks);
+            next_check = now + period;
+        }
+    }
+    double elapsed = (now - start) / 1e9;
+    long moved = atomic_load(&migrations) - migrations_before;
+
+    atomic_store(&stop, 1);
+    pthread_join(thread, NULL);
+    schedstat_close(&r);
+    epoch_detector_destroy(&d);
+
+    struct bench_summary sum;
+    bench_summarize(lat, taken, &sum);
+    printf("affinity calls:  %ld (%.0f/s, %ld errors)\n", calls, calls / elapsed, errors);
+    printf("call cost:       p50 %llu ns, p99 %llu ns, max %llu ns\n",
+           (unsigned long long)sum.p50, (unsigned long long)sum.p99,
+           (unsigned long long)sum.max);
+    printf("migrations:      %ld (%.0f/s, %.2f per call)\n", moved, moved / elapsed,
+           calls ? (double)moved / calls : 0.0);
+    bench_metric(sum.p50, "migration_storm.setaffinity_p50_ns");
+    bench_metric(moved ? 1e9 * elapsed / moved : 0, "migration_storm.ns_per_migration");
+
+    int failed = errors > 0;
+    if (checks.have_list) {
+        printf("CPU list checks: %ld samples, %ld epoch reset(s), %ld outside the rotation, "
+               "%ld missing a visited CPU\n", checks.samples, checks.resets, checks.outside,
+               checks.missing);
+        failed = failed || checks.outside || checks.missing;
+    } else {
+        printf("CPU list checks: skipped, this kernel reports no epoch CPU list\n");
+    }
+    free(lat);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,41 +1,465 @@
-// multithread_sample.c
+/* multithread_sample.c
+
+   Multithreaded workload for the schedstat epoch CPU list.
+
+   By default it spins `nthreads` threads forever, as a target for
+   schedstat_monitor and friends.
+
+   With -m it measures instead, in two parts:
+
+     1. Every worker is created pinned to one CPU of the -c list (round
+        robin; by default every allowed CPU), does a fixed amount of work
+        (-w loop iterations) and parks. The schedstat of every worker
+        (/proc/self/task/<tid>/schedstat) and of the thread-group leader
+        (/proc/self/schedstat) is then read. A worker's CPU list may only
+        contain the CPU it is pinned to. The leader's CPU list and
+        exec_time are compared with the union of the workers' lists and
+        the sum of their exec_times, to show whether the process-level file
+        describes the leader thread alone or the whole thread group.
+
+     2. For every thread count of -s, that many idle threads are parked
+        and the cost of reading is measured: the leader's file (whose cost
+        grows with the thread count if the kernel aggregates the group),
+        and a sweep over every thread's file, both with the files kept
+        open (pread, as schedstat_reader.h does) and with an
+        open/read/close per file.
+
+   Compile with:
+       gcc -O2 -Wall -pthread -o multithread_sample multithread_sample.c
+
+   Usage:
+       ./multithread_sample [nthreads]
+       ./multithread_sample -m [-c cpulist] [-w iterations] [-s counts] [-r repeats] [nthreads]
+*/
+
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "../common/bench.h"
+#include "cpulist.h"
+#include "schedstat_reader.h"
+
+#define IDLE_STACK_SIZE (64 * 1024)
+
+static int measure = 0;
+static const char *cpu_spec = NULL;
+static long work = 200000000;
+static const char *scale_spec = "1,10,100,1000,4000";
+static int repeats = 20;
 
 void *worker(void *arg) {
     volatile unsigned long long counter = 0;
+    (void)arg;
     while (1) {
         counter++; // Busy work to keep the CPU busy
     }
     return NULL;
 }
 
+/* ---- -m: pinned fixed work, then per-thread vs. leader schedstat ---- */
+
+struct pinned {
+    pthread_t thread;
+    pid_t tid;
+    int cpu;
+};
+
+static pthread_barrier_t started, finished, released;
+
+static void *pinned_worker(void *arg) {
+    struct pinned *w = arg;
+    volatile unsigned long counter = 0;
+
+    w->tid = syscall(SYS_gettid);
+    pthread_barrier_wait(&started);
+    for (long i = 0; i < work; i++)
+        counter++;
+    /* Park, still alive, until the main thread has sampled everyone. */
+    pthread_barrier_wait(&finished);
+    pthread_barrier_wait(&released);
+    return NULL;
+}
+
+static char buf[SCHEDSTAT_BUF_SIZE];
+
+/* Read the schedstat of tid (0: the leader, /proc/self/schedstat) into *s
+   and its CPU list into set. Returns 0, or -1 with a message printed. */
+static int sample_thread(pid_t tid, struct schedstat_sample *s, cpu_set_t *set, size_t setsize) {
+    struct schedstat_reader r;
+    if (schedstat_open(&r, getpid(), tid, buf, sizeof(buf)) == -1 || schedstat_read(&r, s) == -1) {
+        fprintf(stderr, "schedstat of %d: %s\n", tid ? tid : getpid(), strerror(errno));
+        schedstat_close(&r);
+        return -1;
+    }
+    schedstat_close(&r);
+    CPU_ZERO_S(setsize, set);
+    if (s->cpu_list && cpulist_parse(s->cpu_list, s->cpu_list_len, set, setsize) == -1) {
+        fprintf(stderr, "malformed CPU list of %d: %.*s\n", tid, (int)s->cpu_list_len, s->cpu_list);
+        return -1;
+    }
+    return 0;
+}
+
+struct spawner {
+    struct pinned *w;
+    int nthreads;
+};
+
+/* Create the pinned workers from a thread of their own that first moves to
+   each worker's CPU: a new thread inherits its creator's affinity at
+   clone(), so it never runs anywhere else, whereas
+   pthread_attr_setaffinity_np() only applies once the thread exists. A
+   separate creator keeps these hops out of the leader's CPU list, which is
+   compared with the workers' below. Exits on error. */
+static void *spawn_pinned(void *arg) {
+    struct spawner *sp = arg;
+    size_t setsize = CPU_ALLOC_SIZE(CPULIST_MAX_CPUS);
+    cpu_set_t *set = CPU_ALLOC(CPULIST_MAX_CPUS);
+
+    if (!set) {
+        perror("CPU_ALLOC");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < sp->nthreads; i++) {
+        struct pinned *w = &sp->w[i];
+        CPU_ZERO_S(setsize, set);
+        CPU_SET_S(w->cpu, setsize, set);
+        if (sched_setaffinity(0, setsize, set) == -1) {
+            fprintf(stderr, "sched_setaffinity (CPU %d): %s\n", w->cpu, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        int err = pthread_create(&w->thread, NULL, pinned_worker, w);
+        if (err) {
+            fprintf(stderr, "pthread_create (pinned to CPU %d): %s\n", w->cpu, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+    CPU_FREE(set);
+    return NULL;
+}
+
+static int run_pinned(int nthreads, const cpu_set_t *cpus, size_t cpus_size) {
+    size_t setsize = CPU_ALLOC_SIZE(CPULIST_MAX_CPUS);
+    cpu_set_t *set = CPU_ALLOC(CPULIST_MAX_CPUS), *all = CPU_ALLOC(CPULIST_MAX_CPUS);
+    struct pinned *w = calloc(nthreads, sizeof(*w));
+    int ncpus = 0, *cpu_of = calloc(cpus_size * 8, sizeof(int)), failures = 0;
+    char list[256];
+
+    if (!set || !all || !w || !cpu_of) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    for (int c = 0; c < (int)cpus_size * 8; c++)
+        if (CPU_ISSET_S(c, cpus_size, cpus))
+            cpu_of[ncpus++] = c;
+
+    pthread_barrier_init(&started, NULL, nthreads + 1);
+    pthread_barrier_init(&finished, NULL, nthreads + 1);
+    pthread_barrier_init(&released, NULL, nthreads + 1);
+
+    for (int i = 0; i < nthreads; i++)
+        w[i].cpu = cpu_of[i % ncpus];
+    struct spawner sp = { w, nthreads };
+    pthread_t spawner;
+    uint64_t t0 = bench_now_ns();
+    if (pthread_create(&spawner, NULL, spawn_pinned, &sp) != 0) {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(spawner, NULL);
+    pthread_barrier_wait(&started);
+    pthread_barrier_wait(&finished);
+    double secs = (bench_now_ns() - t0) / 1e9;
+
+    printf("%d worker(s) x %ld iterations on %d CPU(s), %.3f s wall\n", nthreads, work, ncpus, secs);
+    printf("%-8s %-8s %5s %12s  %s\n", "thread", "tid", "cpu", "exec(ms)", "cpu_list");
+
+    struct schedstat_sample s;
+    unsigned long long sum_exec = 0;
+    int have_lists = 1;
+    CPU_ZERO_S(setsize, all);
+    for (int i = 0; i < nthreads; i++) {
+        if (sample_thread(w[i].tid, &s, set, setsize) == -1) {
+            failures++;
+            continue;
+        }
+        have_lists = have_lists && s.cpu_list;
+        sum_exec += s.exec_time;
+        CPU_OR_S(setsize, all, all, set);
+        printf("%-8d %-8d %5d %12.3f  %.*s\n", i, w[i].tid, w[i].cpu, s.exec_time / 1e6,
+               s.cpu_list ? (int)s.cpu_list_len : 6, s.cpu_list ? s.cpu_list : "(none)");
+        /* Pinned from creation: nothing but its own CPU (empty after an
+           epoch reset while parked). */
+        CPU_CLR_S(w[i].cpu, setsize, set);
+        if (CPU_COUNT_S(setsize, set) > 0) {
+            printf("[FAIL] thread %d pinned to CPU %d has CPU list %.*s\n", i, w[i].cpu,
+                   (int)s.cpu_list_len, s.cpu_list);
+            failures++;
+        }
+    }
+
+    if (sample_thread(0, &s, set, setsize) == 0) {
+        printf("%-8s %-8d %5s %12.3f  %.*s\n", "leader", getpid(), "-", s.exec_time / 1e6,
+               s.cpu_list ? (int)s.cpu_list_len : 6, s.cpu_list ? s.cpu_list : "(none)");
+        printf("\nLeader exec_time %.3f ms vs. %.3f ms summed over the workers: %s\n",
+               s.exec_time / 1e6, sum_exec / 1e6,
+               s.exec_time >= sum_exec * 0.9 ? "the leader's file covers the whole thread group"
+                                             : "the leader's file covers the leader thread only");
+        if (have_lists && s.cpu_list) {
+            cpulist_format(all, setsize, list, sizeof(list));
+            printf("Union of the workers' CPU lists: %s\n", list);
+            CPU_AND_S(setsize, set, set, all);
+            if (CPU_EQUAL_S(setsize, set, all)) {
+                printf("The leader's CPU list includes the union: it is process-wide\n");
+            } else {
+                CPU_XOR_S(setsize, set, set, all);
+                cpulist_format(set, setsize, list, sizeof(list));
+                printf("The leader's CPU list misses %s of the union: it is per-thread\n", list);
+            }
+        } else {
+            printf("This kernel reports no epoch CPU list; only exec_time can be compared\n");
+        }
+    } else {
+        failures++;
+    }
+
+    pthread_barrier_wait(&released);
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(w[i].thread, NULL);
+    pthread_barrier_destroy(&started);
+    pthread_barrier_destroy(&finished);
+    pthread_barrier_destroy(&released);
+    CPU_FREE(set);
+    CPU_FREE(all);
+    free(w);
+    free(cpu_of);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* ---- -m: read cost against the number of threads ---- */
+
+static pid_t *idle_tids;
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static int idle_ready, idle_released;
+
+static void *idle_thread(void *arg) {
+    pthread_mutex_lock(&idle_lock);
+    idle_tids[(long)arg] = syscall(SYS_gettid);
+    idle_ready++;
+    pthread_cond_broadcast(&idle_cond);
+    while (!idle_released)
+        pthread_cond_wait(&idle_cond, &idle_lock);
+    pthread_mutex_unlock(&idle_lock);
+    return NULL;
+}
+
+/* Let the idle threads go and join them. */
+static void release_idle(pthread_t *threads, int n) {
+    pthread_mutex_lock(&idle_lock);
+    idle_released = 1;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&idle_lock);
+    for (int i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+}
+
+/* Median cost in ns of sweeping over the schedstat of every idle thread,
+   with the files kept open (readers != NULL) or reopened on every read. */
+static uint64_t sweep_cost(int n, struct schedstat_reader *readers, uint64_t *samples) {
+    struct schedstat_sample s;
+    for (int r = 0; r < repeats; r++) {
+        uint64_t t0 = bench_now_ns();
+        for (int i = 0; i < n; i++) {
+            if (readers) {
+                schedstat_read(&readers[i], &s);
+            } else {
+                struct schedstat_reader one;
+                if (schedstat_open(&one, getpid(), idle_tids[i], buf, sizeof(buf)) == 0)
+                    schedstat_read(&one, &s);
+                schedstat_close(&one);
+            }
+        }
+        samples[r] = bench_now_ns() - t0;
+    }
+    struct bench_summary sum;
+    bench_summarize(samples, repeats, &sum);
+    return sum.p50;
+}
+
+/* Returns 0, or -1 if no more threads can be created. */
+static int run_scale(int n) {
+    pthread_t *threads = calloc(n, sizeof(*threads));
+    struct schedstat_reader *readers = calloc(n, sizeof(*readers));
+    uint64_t *samples = calloc(repeats > 1000 ? repeats : 1000, sizeof(*samples));
+    idle_tids = calloc(n, sizeof(*idle_tids));
+    if (!threads || !readers || !samples || !idle_tids) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, IDLE_STACK_SIZE);
+    idle_ready = idle_released = 0;
+    int created = 0, err = 0;
+    for (; created < n; created++)
+        if ((err = pthread_create(&threads[created], &attr, idle_thread, (void *)(long)created)))
+            break;
+    pthread_attr_destroy(&attr);
+    if (err) {
+        fprintf(stderr, "%d threads: pthread_create: %s\n", n, strerror(err));
+        release_idle(threads, created);
+        free(threads);
+        free(readers);
+        free(samples);
+        free(idle_tids);
+        return -1;
+    }
+    pthread_mutex_lock(&idle_lock);
+    while (idle_ready < n)
+        pthread_cond_wait(&idle_cond, &idle_lock);
+    pthread_mutex_unlock(&idle_lock);
+
+    /* The leader's file, once per sample. */
+    struct schedstat_reader leader;
+    struct schedstat_sample s;
+    schedstat_open(&leader, getpid(), 0, buf, sizeof(buf));
+    for (int i = 0; i < 1000; i++) {
+        uint64_t t0 = bench_now_ns();
+        schedstat_read(&leader, &s);
+        samples[i] = bench_now_ns() - t0;
+    }
+    schedstat_close(&leader);
+    struct bench_summary lsum;
+    bench_summarize(samples, 1000, &lsum);
+
+    int opened = 0;
+    for (; opened < n; opened++)
+        if (schedstat_open(&readers[opened], getpid(), idle_tids[opened], buf, sizeof(buf)) == -1)
+            break;
+    uint64_t kept = opened == n ? sweep_cost(n, readers, samples) : 0;
+    for (int i = 0; i < opened; i++)
+        schedstat_close(&readers[i]);
+    uint64_t reopened = sweep_cost(n, NULL, samples);
+
+    printf("%8d %14llu %14.0f %14.0f %12.3f\n", n, (unsigned long long)lsum.p50,
+           kept ? (double)kept / n : 0.0, (double)reopened / n, (kept ? kept : reopened) / 1e6);
+    if (opened < n)
+        printf("%8s (pread sweep skipped: only %d files could be kept open)\n", "", opened);
+    bench_metric(lsum.p50, "multithread.t%d.leader_read_p50_ns", n);
+    if (kept)
+        bench_metric((double)kept / n, "multithread.t%d.pread_per_thread_ns", n);
+    bench_metric((double)reopened / n, "multithread.t%d.open_per_thread_ns", n);
+    fflush(stdout);
+
+    release_idle(threads, n);
+    free(threads);
+    free(readers);
+    free(samples);
+    free(idle_tids);
+    return 0;
+}
+
+static int run_measure(int nthreads) {
+    size_t cpus_size;
+    cpu_set_t *cpus;
+    if (cpu_spec) {
+        cpus = cpulist_parse_alloc(cpu_spec, strlen(cpu_spec), &cpus_size);
+        if (!cpus || CPU_COUNT_S(cpus_size, cpus) == 0) {
+            fprintf(stderr, "bad CPU list \"%s\": expected e.g. 0-3,8\n", cpu_spec);
+            return EXIT_FAILURE;
+        }
+    } else {
+        cpus_size = CPU_ALLOC_SIZE(CPULIST_MAX_CPUS);
+        cpus = CPU_ALLOC(CPULIST_MAX_CPUS);
+        if (!cpus || sched_getaffinity(0, cpus_size, cpus) == -1) {
+            perror("sched_getaffinity");
+            return EXIT_FAILURE;
+        }
+    }
+    int status = run_pinned(nthreads, cpus, cpus_size);
+    CPU_FREE(cpus);
+
+    /* Keep one descriptor per thread open in the pread sweep. */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    printf("\nRead cost against thread count (%d sweep(s) each):\n", repeats);
+    printf("%8s %14s %14s %14s %12s\n", "threads", "leader(ns)", "pread/thr(ns)",
+           "open/thr(ns)", "sweep(ms)");
+    const char *p = scale_spec;
+    for (;;) {
+        char *end;
+        long n = strtol(p, &end, 10);
+        if (end == p || n < 1) {
+            fprintf(stderr, "bad thread counts \"%s\": expected e.g. 1,10,100\n", scale_spec);
+            return EXIT_FAILURE;
+        }
+        if (run_scale((int)n) == -1)
+            break;
+        if (*end != ',')
+            break;
+        p = end + 1;
+    }
+    return status;
+}
+
 int main(int argc, char *argv[]) {
     int nthreads = 4;  // Default to 4 threads
-    if (argc > 1) {
-        nthreads = atoi(argv[1]);
+    int opt;
+    while ((opt = getopt(argc, argv, "mc:w:s:r:")) != -1) {
+        switch (opt) {
+        case 'm': measure = 1; break;
+        case 'c': cpu_spec = optarg; break;
+        case 'w': work = atol(optarg); break;
+        case 's': scale_spec = optarg; break;
+        case 'r': repeats = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [nthreads]\n"
+                    "       %s -m [-c cpulist] [-w iterations] [-s counts] [-r repeats] [nthreads]\n",
+                    argv[0], argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc) {
+        nthreads = atoi(argv[optind]);
         if(nthreads < 1) nthreads = 1;
     }
-    
+    if (work < 0 || repeats < 1) {
+        fprintf(stderr, "iterations must be >= 0 and repeats >= 1\n");
+        return EXIT_FAILURE;
+    }
+    if (measure)
+        return run_measure(nthreads);
+
     pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
     if (!threads) {
         perror("malloc");
         exit(EXIT_FAILURE);
     }
-    
+
     for (int i = 0; i < nthreads; i++) {
         if (pthread_create(&threads[i], NULL, worker, NULL)) {
             perror("pthread_create");
             exit(EXIT_FAILURE);
         }
     }
-    
+
     // Wait for threads (in practice, they run forever)
     for (int i = 0; i < nthreads; i++) {
         pthread_join(threads[i], NULL);
     }
-    
+
     free(threads);
     return 0;
-}
\ No newline at end of file
+}
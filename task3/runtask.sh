@@ -4,7 +4,8 @@
 # It starts a CPU-bound process, then for each CPU combination it:
 #   - Sets CPU affinity. For multi-CPU combinations (with commas), it sets affinity
 #     to each CPU individually with a 2-second pause in between.
-#   - Monitors the schedstat output for 10 seconds to observe the changes.
+#   - Monitors the schedstat output for 10 seconds to observe the changes,
+#     using schedstat_monitor (gcc -O2 -o schedstat_monitor schedstat_monitor.c -lpthread).
 
 echo "Starting a CPU-bound process..."
 ( while true; do :; done ) &
@@ -35,51 +36,13 @@ for CPU in "${CPU_COMBS[@]}"; do
 		sleep 2
     fi
 
-        # Monitor schedstat for 10 seconds after applying affinity
-    END=$((SECONDS + 10))
-    while [ $SECONDS -lt $END ]; do
-        if [ -e /proc/$PID/schedstat ]; then
-            SCHEDSTAT=$(cat /proc/$PID/schedstat 2>/dev/null)
-            echo "Time $SECONDS sec - schedstat: $SCHEDSTAT"
-            
-            # # Extract the CPU information from the last column (enclosed in square brackets)
-            # CPU_INFO=$(echo "$SCHEDSTAT" | awk '{print $NF}' | tr -d '[]')
-            
-            # # Verify CPU information matches expected CPU affinity
-            # if [[ "$CPU" == *,* ]]; then
-            #     # For multi-CPU combinations, validate the format with comma or range notation
-            #     # Convert current CPU into expected format for comparison
-            #     EXPECTED_CPUS=$(echo "$CPU" | tr ',' ' ' | tr ' ' '\n' | sort -n | uniq)
-            #     FIRST_CPU=$(echo "$EXPECTED_CPUS" | head -n 1)
-            #     LAST_CPU=$(echo "$EXPECTED_CPUS" | tail -n 1)
-                
-            #     # Check if continuous range or comma-separated list
-            #     if [[ $(echo "$EXPECTED_CPUS" | wc -l) -eq $((LAST_CPU - FIRST_CPU + 1)) ]]; then
-            #         # Continuous range
-            #         EXPECTED_FORMAT="${FIRST_CPU}-${LAST_CPU}"
-            #     else
-            #         # Non-continuous range, should be comma-separated
-            #         EXPECTED_FORMAT=$(echo "$EXPECTED_CPUS" | tr '\n' ', ' | sed 's/,$//')
-            #     fi
-                
-            #     if [[ "$CPU_INFO" == "$EXPECTED_FORMAT" || "$CPU_INFO" == *,* && "$EXPECTED_FORMAT" == *,* ]]; then
-            #         echo "✓ CPU info matches expected: [$CPU_INFO]"
-            #     else
-            #         echo "✗ CPU info mismatch: got [$CPU_INFO], expected [$EXPECTED_FORMAT] for CPU setting $CPU"
-            #     fi
-            # else
-            #     # For single CPU, just check the number matches
-            #     if [[ "$CPU_INFO" == "$CPU" ]]; then
-            #         echo "✓ CPU info matches expected: [$CPU_INFO]"
-            #     else
-            #         echo "✗ CPU info mismatch: got [$CPU_INFO], expected [$CPU] for CPU setting $CPU"
-            #     fi
-            # fi
-        else
-            echo "/proc/$PID/schedstat not available."
-            break
-        fi
-    done
+    # Monitor schedstat for 10 seconds after applying affinity, sampling
+    # every 100 ms from a single long-lived monitor instead of one cat per
+    # sample.
+    if ! ./schedstat_monitor -i 100000 -d 10 "$PID"; then
+        echo "/proc/$PID/schedstat not available."
+        break
+    fi
 done
 
 # Cleanup: terminate the background process
@@ -0,0 +1,410 @@
+/* schedstat_monitor.c
+
+   Multi-task /proc/<pid>/schedstat monitor, replacing the `cat` loops in
+   runtask.sh and test_schedstat.sh.
+
+   Every monitored PID (or, with -t, every thread of it) keeps its schedstat
+   file open (schedstat_reader.h). A single thread drives everything from
+   one epoll set:
+
+     - a periodic timerfd fires every sampling interval; on each tick every
+       live task is sampled with one pread();
+     - each monitored process has a pidfd in the same epoll set, which
+       becomes readable when the process exits; threads are detected as
+       gone when their read fails.
+
+   Samples are pushed into a single-producer/single-consumer lock-free ring
+   buffer, with the CPU list parsed into a bitmap (cpulist.h) so that lists
+   of any length fit, and a separate writer thread formats them as text
+   lines:
+
+       <timestamp_ns> <tid> <exec_ns> <wait_ns> <timeslices> <cpu_list>
+       <timestamp_ns> <tid> EXIT
+
+   The sampling thread never blocks on output: if the writer falls behind,
+   samples are dropped and counted. A CPU list that cannot be parsed (or
+   names a CPU beyond CPU_SETSIZE) is written as "[?]" and counted. A
+   summary goes to stderr at the end.
+
+   With -w the samples are instead appended straight from the sampling
+   thread to a compact binary time series (schedstat_ts.h), which costs a
+   few memory stores per sample; convert it with schedstat_ts2csv.
+
+   Compile with:
+       gcc -O2 -Wall -o schedstat_monitor schedstat_monitor.c -lpthread
+
+   Usage:
+       ./schedstat_monitor [-i interval_us] [-d seconds] [-t] [-o file | -w file] pid...
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "cpulist.h"
+#include "schedstat_reader.h"
+#include "schedstat_ts.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+/* Ring capacity in samples; must be a power of two. */
+#define RING_SIZE (1 << 16)
+/* Longest formatted list of CPU_SETSIZE CPUs: every other one, "dddd,". */
+#define CPU_LIST_MAX (CPU_SETSIZE / 2 * 5 + 3)
+
+struct task {
+    pid_t pid;
+    pid_t tid;
+    int pidfd;          /* -1 for threads other than the leader */
+    int alive;
+    struct schedstat_reader r;
+};
+
+struct record {
+    unsigned long long ts;
+    pid_t tid;
+    int exited;
+    unsigned long long exec_time, wait_time, timeslices;
+    int cpu_list;       /* 1: cpus holds the list; 0: none; -1: unparseable */
+    cpu_set_t cpus;
+};
+
+/* Single-producer/single-consumer ring: the sampler only writes head, the
+   writer only writes tail. */
+static struct record ring[RING_SIZE];
+static atomic_size_t ring_head, ring_tail;
+static atomic_int sampling_done;
+static unsigned long dropped, series_errors, bad_lists;
+
+static struct task *tasks;
+static size_t ntasks, task_cap;
+static char read_buf[SCHEDSTAT_BUF_SIZE];
+static FILE *out;
+static struct ts_writer series;
+static int binary;              /* -w: write series instead of text */
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Reserve the next ring slot, or NULL (and count a drop) if full. */
+static struct record *ring_reserve(void) {
+    size_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    if (head - tail == RING_SIZE) {
+        dropped++;
+        return NULL;
+    }
+    return &ring[head & (RING_SIZE - 1)];
+}
+
+static void ring_publish(void) {
+    size_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct timespec idle = { 0, 1000000 };
+    static char list[CPU_LIST_MAX];
+    for (;;) {
+        size_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+        if (tail == head) {
+            if (atomic_load(&sampling_done))
+                break;
+            fflush(out);
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        for (; tail != head; tail++) {
+            struct record *rec = &ring[tail & (RING_SIZE - 1)];
+            if (rec->exited) {
+                fprintf(out, "%llu %d EXIT\n", rec->ts, rec->tid);
+                continue;
+            }
+            if (rec->cpu_list > 0)
+                cpulist_format(&rec->cpus, sizeof(rec->cpus), list, sizeof(list));
+            fprintf(out, "%llu %d %llu %llu %llu%s%s\n", rec->ts, rec->tid,
+                    rec->exec_time, rec->wait_time, rec->timeslices,
+                    rec->cpu_list ? " " : "",
+                    rec->cpu_list > 0 ? list : rec->cpu_list ? "[?]" : "");
+        }
+        atomic_store_explicit(&ring_tail, tail, memory_order_release);
+    }
+    fflush(out);
+    return NULL;
+}
+
+static void emit_exit(struct task *t, unsigned long long ts) {
+    if (binary) {
+        ts_writer_exit(&series, t - tasks);
+        return;
+    }
+    struct record *rec = ring_reserve();
+    if (rec) {
+        rec->ts = ts;
+        rec->tid = t->tid;
+        rec->exited = 1;
+        ring_publish();
+    }
+}
+
+static void task_gone(struct task *t, int epfd, unsigned long long ts) {
+    if (!t->alive)
+        return;
+    t->alive = 0;
+    schedstat_close(&t->r);
+    if (t->pidfd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, t->pidfd, NULL);
+        close(t->pidfd);
+        t->pidfd = -1;
+    }
+    emit_exit(t, ts);
+}
+
+static int add_task(pid_t pid, pid_t tid) {
+    if (ntasks == task_cap) {
+        task_cap = task_cap ? task_cap * 2 : 64;
+        struct task *n = realloc(tasks, task_cap * sizeof(*tasks));
+        if (!n)
+            return -1;
+        tasks = n;
+    }
+    struct task *t = &tasks[ntasks];
+    t->pid = pid;
+    t->tid = tid;
+    t->pidfd = -1;
+    t->alive = 1;
+    if (schedstat_open(&t->r, pid, tid == pid ? 0 : tid, read_buf, sizeof(read_buf)) == -1) {
+        fprintf(stderr, "cannot open schedstat of %d/%d: %s\n", pid, tid, strerror(errno));
+        return 0;
+    }
+    if (tid == pid)
+        t->pidfd = syscall(SYS_pidfd_open, pid, 0);
+    if (binary && ts_writer_add_task(&series, pid, tid) == -1)
+        return -1;
+    ntasks++;
+    return 0;
+}
+
+/* Add pid, or with all_threads every thread listed in /proc/<pid>/task. */
+static int add_pid(pid_t pid, int all_threads) {
+    if (!all_threads)
+        return add_task(pid, pid);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "cannot list threads of %d: %s\n", pid, strerror(errno));
+        return 0;
+    }
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        pid_t tid = atoi(de->d_name);
+        if (tid > 0 && add_task(pid, tid) == -1) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+static void sample_all(int epfd, unsigned long long ts, size_t *live) {
+    struct schedstat_sample s;
+    *live = 0;
+    for (size_t i = 0; i < ntasks; i++) {
+        struct task *t = &tasks[i];
+        if (!t->alive)
+            continue;
+        if (schedstat_read(&t->r, &s) == -1) {
+            task_gone(t, epfd, ts);
+            continue;
+        }
+        (*live)++;
+        if (binary) {
+            if (ts_writer_sample(&series, i, &s) == -1)
+                series_errors++;
+            continue;
+        }
+        struct record *rec = ring_reserve();
+        if (!rec)
+            continue;
+        rec->ts = ts;
+        rec->tid = t->tid;
+        rec->exited = 0;
+        rec->exec_time = s.exec_time;
+        rec->wait_time = s.wait_time;
+        rec->timeslices = s.timeslices;
+        rec->cpu_list = 0;
+        if (s.cpu_list) {
+            rec->cpu_list = 1;
+            if (cpulist_parse(s.cpu_list, s.cpu_list_len, &rec->cpus, sizeof(rec->cpus)) == -1) {
+                rec->cpu_list = -1;
+                bad_lists++;
+            }
+        }
+        ring_publish();
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-i interval_us] [-d seconds] [-t] [-o file | -w file] pid...\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    long interval_us = 10000;
+    double duration = 0;        /* 0: until every task has exited */
+    int all_threads = 0;
+    const char *out_path = NULL, *series_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:d:to:w:")) != -1) {
+        switch (opt) {
+        case 'i': interval_us = atol(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 't': all_threads = 1; break;
+        case 'o': out_path = optarg; break;
+        case 'w': series_path = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind == argc || interval_us < 1 || (out_path && series_path))
+        usage(argv[0]);
+
+    out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        return EXIT_FAILURE;
+    }
+    if (series_path) {
+        if (ts_writer_open(&series, series_path, now_ns()) == -1) {
+            perror(series_path);
+            return EXIT_FAILURE;
+        }
+        binary = 1;
+    }
+
+    /* Two descriptors per task: lift the soft limit as far as allowed. */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (add_pid(atoi(argv[i]), all_threads) == -1) {
+            perror("add task");
+            return EXIT_FAILURE;
+        }
+    }
+    if (ntasks == 0) {
+        fprintf(stderr, "no tasks to monitor\n");
+        return EXIT_FAILURE;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (epfd < 0 || tfd < 0) {
+        perror("epoll/timerfd");
+        return EXIT_FAILURE;
+    }
+    struct itimerspec its = {
+        .it_interval = { interval_us / 1000000, (interval_us % 1000000) * 1000 },
+        .it_value = { interval_us / 1000000, (interval_us % 1000000) * 1000 },
+    };
+    timerfd_settime(tfd, 0, &its, NULL);
+
+    /* Event data: -1 for the timer, otherwise the task index. */
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)-1 };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev);
+    for (size_t i = 0; i < ntasks; i++) {
+        if (tasks[i].pidfd < 0)
+            continue;
+        ev.data.u64 = i;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, tasks[i].pidfd, &ev);
+    }
+
+    pthread_t writer;
+    if (!binary && pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        perror("pthread_create");
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long start = now_ns();
+    unsigned long long end = duration > 0 ? start + (unsigned long long)(duration * 1e9) : 0;
+    unsigned long ticks = 0, missed_ticks = 0, samples = 0;
+    size_t live = ntasks;
+    struct epoll_event events[64];
+
+    while (live > 0 && (!end || now_ns() < end)) {
+        int n = epoll_wait(epfd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            unsigned long long ts = now_ns();
+            if (events[i].data.u64 == (uint64_t)-1) {
+                uint64_t expirations;
+                if (read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                    continue;
+                ticks++;
+                missed_ticks += expirations - 1;
+                if (binary && ts_writer_tick(&series, ts) == -1)
+                    series_errors++;
+                sample_all(epfd, ts, &live);
+                samples += live;
+            } else {
+                task_gone(&tasks[events[i].data.u64], epfd, ts);
+            }
+        }
+    }
+
+    atomic_store(&sampling_done, 1);
+    if (binary) {
+        size_t bytes = series.len;
+        if (ts_writer_close(&series) == -1)
+            series_errors++;
+        fprintf(stderr, "schedstat_monitor: wrote %zu bytes to %s (%lu errors)\n",
+                bytes, series_path, series_errors);
+    } else {
+        pthread_join(writer, NULL);
+    }
+
+    double secs = (now_ns() - start) / 1e9;
+    fprintf(stderr, "schedstat_monitor: %zu task(s), %lu ticks in %.2f s (%lu missed), "
+            "%lu samples, %lu dropped, %lu unparseable CPU list(s)\n", ntasks, ticks, secs,
+            missed_ticks, samples, dropped, bad_lists);
+
+    for (size_t i = 0; i < ntasks; i++)
+        if (tasks[i].alive) {
+            schedstat_close(&tasks[i].r);
+            if (tasks[i].pidfd >= 0)
+                close(tasks[i].pidfd);
+        }
+    free(tasks);
+    if (out != stdout)
+        fclose(out);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+/* schedstat_read_scale.c
+
+   Scalability of concurrent /proc/<pid>/schedstat readers, as monitoring
+   agents that sample from many threads at once would stress it.
+
+   A CPU-bound target process spins, counting its loop iterations in
+   shared memory. For every reader count N (by default 1, 2, 4, ... up to
+   the number of CPUs readers can use, plus that number), N threads each
+   keep their own descriptor of the target's schedstat and pread() and
+   parse it (schedstat_reader.h) as fast as they can for `seconds`. The
+   report gives the total and per-thread reads per second, the cost of one
+   read, the scaling efficiency against one reader, and how much the target
+   slowed down against a baseline phase without readers: formatting the CPU
+   list and any locking on the read side show up in one or the other.
+
+   With -D every reader has a target of its own instead of all hammering
+   the same one (the targets then share the target CPU).
+
+   With more than one allowed CPU the target(s) are pinned to the last one
+   and the readers spread over the others, so the target's slowdown is not
+   just the readers taking its CPU; with one CPU everything shares it and
+   the slowdown includes that.
+
+   Compile with:
+       gcc -O2 -Wall -pthread -o schedstat_read_scale schedstat_read_scale.c
+
+   Usage:
+       ./schedstat_read_scale [-d seconds] [-n max_readers] [-D]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../common/bench.h"
+#include "schedstat_reader.h"
+
+static double seconds = 2.0;
+static int max_readers = 0;
+static int distinct = 0;
+
+/* Shared with the targets: their iteration counts. */
+static atomic_ulong *work;
+
+static int target_cpu = -1;
+static int reader_cpus[CPU_SETSIZE], nreader_cpus;
+
+static pid_t *targets;
+static int ntargets;
+
+struct reader {
+    pthread_t thread;
+    pid_t target;
+    int cpu;
+    unsigned long reads, errors;
+};
+
+static pthread_barrier_t ready;
+static atomic_int stop;
+
+static void run_target(int idx) {
+    if (target_cpu >= 0)
+        bench_pin_cpu(target_cpu);
+    unsigned long local = 0;
+    for (;;) {
+        if (++local % 1024 == 0)
+            atomic_store_explicit(&work[idx], local, memory_order_relaxed);
+    }
+}
+
+static unsigned long total_work(void) {
+    unsigned long sum = 0;
+    for (int i = 0; i < ntargets; i++)
+        sum += atomic_load_explicit(&work[i], memory_order_relaxed);
+    return sum;
+}
+
+static void *reader_main(void *arg) {
+    struct reader *rd = arg;
+    struct schedstat_reader r;
+    struct schedstat_sample s;
+    char *buf = malloc(SCHEDSTAT_BUF_SIZE);
+
+    if (rd->cpu >= 0)
+        bench_pin_cpu(rd->cpu);
+    int ok = buf && schedstat_open(&r, rd->target, 0, buf, SCHEDSTAT_BUF_SIZE) == 0;
+    pthread_barrier_wait(&ready);
+    while (ok && !atomic_load_explicit(&stop, memory_order_relaxed)) {
+        if (schedstat_read(&r, &s) == 0)
+            rd->reads++;
+        else
+            rd->errors++;
+    }
+    if (ok)
+        schedstat_close(&r);
+    else
+        rd->errors++;
+    free(buf);
+    return NULL;
+}
+
+/* Run one phase with n readers (0: baseline). Returns the reads per second
+   and stores the target's iterations per second in *target_rate. */
+static double run_phase(int n, double *target_rate, unsigned long *errors) {
+    struct reader *rd = calloc(n ? n : 1, sizeof(*rd));
+    if (!rd) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    atomic_store(&stop, 0);
+    pthread_barrier_init(&ready, NULL, n + 1);
+    for (int i = 0; i < n; i++) {
+        rd[i].target = targets[distinct ? i : 0];
+        rd[i].cpu = nreader_cpus ? reader_cpus[i % nreader_cpus] : -1;
+        if (pthread_create(&rd[i].thread, NULL, reader_main, &rd[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_barrier_wait(&ready);
+
+    uint64_t t0 = bench_now_ns();
+    unsigned long w0 = total_work();
+    struct timespec ts = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&ts, NULL);
+    unsigned long w1 = total_work();
+    atomic_store(&stop, 1);
+    double secs = (bench_now_ns() - t0) / 1e9;
+
+    unsigned long reads = 0;
+    *errors = 0;
+    for (int i = 0; i < n; i++) {
+        pthread_join(rd[i].thread, NULL);
+        reads += rd[i].reads;
+        *errors += rd[i].errors;
+    }
+    pthread_barrier_destroy(&ready);
+    free(rd);
+    *target_rate = (w1 - w0) / secs;
+    return reads / secs;
+}
+
+static int spawn_targets(int n) {
+    targets = calloc(n, sizeof(*targets));
+    if (!targets)
+        return -1;
+    for (ntargets = 0; ntargets < n; ntargets++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0)
+            return -1;
+        if (pid == 0)
+            run_target(ntargets);
+        targets[ntargets] = pid;
+    }
+    /* Let every target get going before anything is measured. */
+    for (int i = 0; i < n; i++)
+        while (atomic_load(&work[i]) == 0)
+            sched_yield();
+    return 0;
+}
+
+static void kill_targets(void) {
+    for (int i = 0; i < ntargets; i++)
+        kill(targets[i], SIGKILL);
+    for (int i = 0; i < ntargets; i++)
+        waitpid(targets[i], NULL, 0);
+    free(targets);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:D")) != -1) {
+        switch (opt) {
+        case 'd': seconds = atof(optarg); break;
+        case 'n': max_readers = atoi(optarg); break;
+        case 'D': distinct = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d seconds] [-n max_readers] [-D]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (seconds <= 0 || max_readers < 0) {
+        fprintf(stderr, "seconds must be positive and max_readers >= 0\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Target on the last allowed CPU, readers on the others. */
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        return EXIT_FAILURE;
+    }
+    int ncpus = CPU_COUNT(&allowed);
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, &allowed))
+            continue;
+        if (ncpus > 1 && nreader_cpus == ncpus - 1)
+            target_cpu = c;
+        else
+            reader_cpus[nreader_cpus++] = c;
+    }
+    if (max_readers == 0)
+        max_readers = nreader_cpus;
+
+    work = mmap(NULL, max_readers * sizeof(*work), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (work == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    if (spawn_targets(distinct ? max_readers : 1) == -1) {
+        perror("fork");
+        kill_targets();
+        return EXIT_FAILURE;
+    }
+
+    if (target_cpu >= 0)
+        printf("%s on CPU %d, up to %d reader(s) on %d other CPU(s), %.1f s per phase\n",
+               distinct ? "One target per reader" : "One shared target", target_cpu, max_readers,
+               nreader_cpus, seconds);
+    else
+        printf("%s, up to %d reader(s), all sharing the only CPU, %.1f s per phase\n",
+               distinct ? "One target per reader" : "One shared target", max_readers, seconds);
+
+    double base_rate;
+    unsigned long errors;
+    run_phase(0, &base_rate, &errors);
+    printf("%8s %14s %14s %12s %10s %14s %10s\n", "readers", "reads/s", "reads/s/thr",
+           "ns/read", "scaling", "target(it/s)", "slowdown");
+    printf("%8d %14s %14s %12s %10s %14.3g %9.1f%%\n", 0, "-", "-", "-", "-", base_rate, 0.0);
+
+    double single = 0;
+    int failures = 0;
+    for (int n = 1;; n = n * 2 < max_readers ? n * 2 : max_readers) {
+        double target_rate;
+        double rate = run_phase(n, &target_rate, &errors);
+        if (n == 1)
+            single = rate;
+        double per = rate / n;
+        printf("%8d %14.0f %14.0f %12.0f %9.1f%% %14.3g %9.1f%%", n, rate, per,
+               per ? 1e9 / per : 0.0, single ? 100.0 * rate / (n * single) : 0.0, target_rate,
+               base_rate ? 100.0 * (1 - target_rate / base_rate) : 0.0);
+        if (errors) {
+            printf("  (%lu read errors)", errors);
+            failures++;
+        }
+        printf("\n");
+        fflush(stdout);
+        bench_metric(per ? 1e9 / per : 0, "schedstat_read_scale.%s.r%d.ns_per_read",
+                     distinct ? "distinct" : "shared", n);
+        if (n == max_readers)
+            break;
+    }
+
+    kill_targets();
+    munmap(work, max_readers * sizeof(*work));
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
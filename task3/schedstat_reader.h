@@ -0,0 +1,137 @@
+/* schedstat_reader.h
+
+   Allocation-free reader for the modified /proc/<pid>/schedstat:
+
+       <exec_time_ns> <wait_time_ns> <timeslices> [<cpu_list>]
+
+   The file is opened once and every sample is taken with a single pread()
+   at offset 0 into a buffer owned by the caller, then parsed in place by a
+   hand-written parser: no stdio, no malloc, no copies. The bracketed CPU
+   list is returned as a pointer/length pair into that buffer (brackets
+   included), so it is only valid until the next read.
+
+   Kernels without the epoch CPU list produce only the three counters; the
+   list is then reported as empty (cpu_list == NULL).
+
+   Typical use:
+
+       char buf[SCHEDSTAT_BUF_SIZE];
+       struct schedstat_reader r;
+       struct schedstat_sample s;
+       if (schedstat_open(&r, pid, 0, buf, sizeof(buf)) == 0)
+           while (schedstat_read(&r, &s) == 0)
+               ...;
+       schedstat_close(&r);
+*/
+
+#ifndef SCHEDSTAT_READER_H
+#define SCHEDSTAT_READER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Large enough for a fully fragmented CPU list on an 8192-CPU machine. */
+#define SCHEDSTAT_BUF_SIZE 65536
+
+struct schedstat_sample {
+    unsigned long long exec_time;   /* time spent on the CPU (ns) */
+    unsigned long long wait_time;   /* time spent waiting on a runqueue (ns) */
+    unsigned long long timeslices;  /* number of timeslices run */
+    const char *cpu_list;           /* "[...]" inside the reader buffer, or NULL */
+    size_t cpu_list_len;
+};
+
+struct schedstat_reader {
+    int fd;
+    char *buf;
+    size_t size;
+};
+
+static inline const char *schedstat_parse_u64(const char *p, const char *end,
+                                              unsigned long long *out)
+{
+    unsigned long long v = 0;
+    while (p < end && *p == ' ')
+        p++;
+    if (p == end || *p < '0' || *p > '9')
+        return NULL;
+    while (p < end && *p >= '0' && *p <= '9')
+        v = v * 10 + (unsigned long long)(*p++ - '0');
+    *out = v;
+    return p;
+}
+
+/* Parse one schedstat line of len bytes. Returns 0, or -1 with errno ==
+   EINVAL if the counters are malformed. */
+static inline int schedstat_parse(const char *buf, size_t len, struct schedstat_sample *s)
+{
+    const char *p = buf, *end = buf + len;
+
+    if (!(p = schedstat_parse_u64(p, end, &s->exec_time)) ||
+        !(p = schedstat_parse_u64(p, end, &s->wait_time)) ||
+        !(p = schedstat_parse_u64(p, end, &s->timeslices))) {
+        errno = EINVAL;
+        return -1;
+    }
+    s->cpu_list = NULL;
+    s->cpu_list_len = 0;
+
+    while (p < end && *p == ' ')
+        p++;
+    if (p < end && *p == '[') {
+        const char *close = memchr(p, ']', end - p);
+        if (!close) {
+            errno = EINVAL;
+            return -1;
+        }
+        s->cpu_list = p;
+        s->cpu_list_len = close - p + 1;
+    }
+    return 0;
+}
+
+/* Open /proc/<pid>/schedstat, or /proc/<pid>/task/<tid>/schedstat when tid
+   is non-zero. buf/size is the caller's read buffer. Returns 0 or -1. */
+static inline int schedstat_open(struct schedstat_reader *r, pid_t pid, pid_t tid,
+                                 char *buf, size_t size)
+{
+    char path[64];
+    if (tid)
+        snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+    else
+        snprintf(path, sizeof(path), "/proc/%d/schedstat", pid);
+    r->fd = open(path, O_RDONLY | O_CLOEXEC);
+    r->buf = buf;
+    r->size = size;
+    return r->fd < 0 ? -1 : 0;
+}
+
+/* Take one sample. Returns 0, or -1 with errno set (ESRCH once the task
+   has exited, EOVERFLOW if the line does not fit in the buffer). */
+static inline int schedstat_read(struct schedstat_reader *r, struct schedstat_sample *s)
+{
+    ssize_t len = pread(r->fd, r->buf, r->size, 0);
+    if (len < 0)
+        return -1;
+    if (len == 0) {
+        errno = ESRCH;
+        return -1;
+    }
+    if ((size_t)len == r->size) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    return schedstat_parse(r->buf, (size_t)len, s);
+}
+
+static inline void schedstat_close(struct schedstat_reader *r)
+{
+    if (r->fd >= 0)
+        close(r->fd);
+    r->fd = -1;
+}
+
+#endif /* SCHEDSTAT_READER_H */
@@ -0,0 +1,168 @@
+/* schedstat_sampler.c
+
+   High-frequency /proc/<pid>/schedstat sampler built on schedstat_reader.h.
+
+   Samples a task at a fixed rate (10 kHz by default) using absolute
+   clock_nanosleep() deadlines and reports:
+     - the achieved sampling rate and the number of missed deadlines;
+     - the cost of each read (p50/p99/max);
+     - the sampler's own CPU usage, i.e. how visible it is to the
+       workload it measures.
+
+   With -s the same loop uses the fopen/fscanf/fclose approach of
+   read_schedstat() in task3_tests.c, for comparison.
+
+   If no PID is given, a CPU-bound child is started and sampled.
+
+   Compile with:
+       gcc -O2 -Wall -o schedstat_sampler schedstat_sampler.c
+
+   Usage:
+       ./schedstat_sampler [-p pid] [-f hz] [-d seconds] [-s]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <time.h>
+#include "../common/bench.h"
+#include "schedstat_reader.h"
+
+static pid_t target = 0;
+static long freq = 10000;
+static double duration = 2.0;
+static int use_stdio = 0;
+
+/* The old way: a full fopen/fscanf/fclose per sample. */
+static int read_stdio(pid_t pid, struct schedstat_sample *s, char *cpu_list) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/schedstat", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    int ret = fscanf(fp, "%llu %llu %llu %255[^\n]",
+                     &s->exec_time, &s->wait_time, &s->timeslices, cpu_list);
+    fclose(fp);
+    return ret < 3 ? -1 : 0;
+}
+
+static double cpu_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:f:d:s")) != -1) {
+        switch (opt) {
+        case 'p': target = atoi(optarg); break;
+        case 'f': freq = atol(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 's': use_stdio = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-p pid] [-f hz] [-d seconds] [-s]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (freq < 1 || duration <= 0) {
+        fprintf(stderr, "frequency and duration must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    pid_t burner = 0;
+    if (target == 0) {
+        burner = fork();
+        if (burner < 0) {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (burner == 0) {
+            volatile unsigned long dummy = 0;
+            for (;;)
+                dummy++;
+        }
+        target = burner;
+    }
+
+    long nsamples = (long)(freq * duration);
+    uint64_t *cost = malloc(nsamples * sizeof(*cost));
+    if (!cost) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    static char buf[SCHEDSTAT_BUF_SIZE];
+    char cpu_list[256];
+    struct schedstat_reader r = { .fd = -1 };
+    struct schedstat_sample first, s;
+    if (!use_stdio && schedstat_open(&r, target, 0, buf, sizeof(buf)) == -1) {
+        perror("open schedstat");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t period = 1000000000ULL / freq;
+    long missed = 0, taken = 0, errors = 0;
+    double cpu_start = cpu_time_ns();
+    uint64_t start = bench_now_ns();
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (long i = 0; i < nsamples; i++) {
+        next.tv_nsec += period;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        uint64_t t0 = bench_now_ns();
+        int ret = use_stdio ? read_stdio(target, &s, cpu_list) : schedstat_read(&r, &s);
+        uint64_t t1 = bench_now_ns();
+        if (ret == -1) {
+            errors++;
+            if (errno == ESRCH)
+                break;
+            continue;
+        }
+        if (taken == 0)
+            first = s;
+        cost[taken++] = t1 - t0;
+
+        /* Overran the next deadline: that sample slot is lost. */
+        uint64_t deadline = (uint64_t)next.tv_sec * 1000000000ULL + next.tv_nsec + period;
+        if (t1 > deadline)
+            missed++;
+    }
+
+    double wall = (bench_now_ns() - start) / 1e9;
+    double self_cpu = (cpu_time_ns() - cpu_start) / 1e9;
+    struct bench_summary sum;
+    bench_summarize(cost, taken, &sum);
+
+    printf("Sampled PID %d with %s for %.2f s\n", target,
+           use_stdio ? "fopen/fscanf" : "pread", wall);
+    printf("  samples:       %ld (%.0f Hz achieved, %ld missed deadlines, %ld errors)\n",
+           taken, taken / wall, missed, errors);
+    printf("  read cost:     p50 %llu ns, p99 %llu ns, max %llu ns\n",
+           (unsigned long long)sum.p50, (unsigned long long)sum.p99,
+           (unsigned long long)sum.max);
+    bench_metric(sum.p50, "schedstat.%s.read_p50_ns", use_stdio ? "stdio" : "pread");
+    printf("  sampler CPU:   %.3f s (%.2f%% of one CPU)\n", self_cpu, 100.0 * self_cpu / wall);
+    if (taken > 0)
+        printf("  target exec:   +%.3f s, timeslices +%llu\n",
+               (s.exec_time - first.exec_time) / 1e9, s.timeslices - first.timeslices);
+
+    if (!use_stdio)
+        schedstat_close(&r);
+    free(cost);
+    if (burner) {
+        kill(burner, SIGKILL);
+        waitpid(burner, NULL, 0);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+/* schedstat_ts.h
+
+   Compact binary time-series format for schedstat samples ("SSTS"), and an
+   mmap-based writer for it. schedstat_monitor -w writes it;
+   schedstat_ts2csv converts it back to CSV.
+
+   A file is a fixed header followed by a stream of records. Each record
+   is a one-byte type followed by LEB128 varints:
+
+     TASK   pid tid                 declare the next task index (0, 1, ...)
+     TICK   dt                      new sampling instant, dt ns after the
+                                    previous one (the first is relative to
+                                    the header's start_ns)
+     SAMPLE idx dexec dwait dslices counters of task idx at the current
+                                    tick, as zigzag deltas from its
+                                    previous sample
+     CPUS   idx dexec dwait dslices nbytes bitmap[nbytes]
+                                    as SAMPLE, plus the new epoch CPU set
+                                    (cpu_set_t bytes, trailing zeros cut)
+     EXIT   idx                     task idx has exited
+
+   Only changes are stored: a task whose counters did not move since its
+   last sample gets no record at all (readers carry the previous values
+   forward), and the CPU bitmap is written only when the set changes. A
+   busy task sampled at 1 kHz costs roughly 6-9 bytes per sample, an idle
+   one nothing beyond the shared TICK.
+
+   The writer appends into a shared mapping of the output file, growing it
+   with ftruncate() + mremap(), so a sample is a few stores into memory and
+   no system call. The header's data_len is updated at every tick, so a
+   file cut short by a crash is still readable up to the last full tick.
+
+   Requires _GNU_SOURCE (mremap) to be defined before any system header is
+   included.
+*/
+
+#ifndef SCHEDSTAT_TS_H
+#define SCHEDSTAT_TS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "cpulist.h"
+#include "schedstat_reader.h"
+
+#define TS_MAGIC "SSTS"
+#define TS_VERSION 1
+#define TS_INITIAL_SIZE (1 << 20)
+
+enum ts_record {
+    TS_TASK = 1,
+    TS_TICK = 2,
+    TS_SAMPLE = 3,
+    TS_CPUS = 4,
+    TS_EXIT = 5,
+};
+
+struct ts_header {
+    char magic[4];          /* "SSTS" */
+    uint32_t version;
+    uint64_t start_ns;      /* CLOCK_MONOTONIC base of the first TICK */
+    uint64_t data_len;      /* bytes of complete records after the header */
+};
+
+/* Last values written for a task; deltas are taken against these. */
+struct ts_task_state {
+    unsigned long long exec_time, wait_time, timeslices;
+    unsigned char *cpus;    /* last CPU bitmap written (malloc'd) */
+    size_t cpus_len;
+};
+
+struct ts_writer {
+    int fd;
+    unsigned char *map;
+    size_t cap;             /* mapped (and file) size */
+    size_t len;             /* header + records written so far */
+    unsigned long long last_tick;
+    struct ts_task_state *tasks;
+    size_t ntasks, task_cap;
+    cpu_set_t *scratch;     /* parsed CPU list of the current sample */
+    size_t scratch_size;
+};
+
+/* ---- encoding ---- */
+
+static inline uint64_t ts_zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t ts_unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline unsigned char *ts_put_varint(unsigned char *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+/* Decode a varint from [p, end). Returns the byte after it, or NULL if
+   the input is truncated or overlong. */
+static inline const unsigned char *ts_get_varint(const unsigned char *p,
+                                                 const unsigned char *end, uint64_t *v)
+{
+    uint64_t r = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char b = *p++;
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* ---- writer ---- */
+
+/* Make room for at least `need` more bytes. */
+static inline int ts_writer_reserve(struct ts_writer *w, size_t need)
+{
+    if (w->len + need <= w->cap)
+        return 0;
+    size_t cap = w->cap * 2;
+    while (cap < w->len + need)
+        cap *= 2;
+    if (ftruncate(w->fd, cap) == -1)
+        return -1;
+    void *map = mremap(w->map, w->cap, cap, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED)
+        return -1;
+    w->map = map;
+    w->cap = cap;
+    return 0;
+}
+
+/* Create path and map its first TS_INITIAL_SIZE bytes. start_ns is the
+   time base of the first tick. Returns 0 or -1 with errno set. */
+static inline int ts_writer_open(struct ts_writer *w, const char *path,
+                                 unsigned long long start_ns)
+{
+    memset(w, 0, sizeof(*w));
+    w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w->fd < 0)
+        return -1;
+    w->cap = TS_INITIAL_SIZE;
+    if (ftruncate(w->fd, w->cap) == -1)
+        goto fail;
+    w->map = mmap(NULL, w->cap, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+    if (w->map == MAP_FAILED)
+        goto fail;
+    w->scratch = CPU_ALLOC(CPULIST_MAX_CPUS);
+    w->scratch_size = CPU_ALLOC_SIZE(CPULIST_MAX_CPUS);
+    if (!w->scratch) {
+        munmap(w->map, w->cap);
+        errno = ENOMEM;
+        goto fail;
+    }
+
+    struct ts_header *h = (struct ts_header *)w->map;
+    memcpy(h->magic, TS_MAGIC, 4);
+    h->version = TS_VERSION;
+    h->start_ns = start_ns;
+    h->data_len = 0;
+    w->len = sizeof(*h);
+    w->last_tick = start_ns;
+    return 0;
+
+fail:
+    close(w->fd);
+    w->fd = -1;
+    return -1;
+}
+
+/* Declare a task; returns its index for the other calls, or -1. */
+static inline long ts_writer_add_task(struct ts_writer *w, pid_t pid, pid_t tid)
+{
+    if (w->ntasks == w->task_cap) {
+        size_t cap = w->task_cap ? w->task_cap * 2 : 64;
+        struct ts_task_state *t = realloc(w->tasks, cap * sizeof(*t));
+        if (!t)
+            return -1;
+        w->tasks = t;
+        w->task_cap = cap;
+    }
+    if (ts_writer_reserve(w, 32) == -1)
+        return -1;
+    unsigned char *p = w->map + w->len;
+    *p++ = TS_TASK;
+    p = ts_put_varint(p, pid);
+    p = ts_put_varint(p, tid);
+    w->len = p - w->map;
+    memset(&w->tasks[w->ntasks], 0, sizeof(w->tasks[0]));
+    return w->ntasks++;
+}
+
+/* Start a new sampling instant; commits every record before it. */
+static inline int ts_writer_tick(struct ts_writer *w, unsigned long long ts)
+{
+    ((struct ts_header *)w->map)->data_len = w->len - sizeof(struct ts_header);
+    if (ts_writer_reserve(w, 16) == -1)
+        return -1;
+    unsigned char *p = w->map + w->len;
+    *p++ = TS_TICK;
+    p = ts_put_varint(p, ts - w->last_tick);
+    w->len = p - w->map;
+    w->last_tick = ts;
+    return 0;
+}
+
+/* Record a sample of task idx at the current tick. */
+static inline int ts_writer_sample(struct ts_writer *w, size_t idx,
+                                   const struct schedstat_sample *s)
+{
+    struct ts_task_state *t = &w->tasks[idx];
+    size_t nbytes = 0;
+    int cpus_changed = 0;
+
+    if (s->cpu_list &&
+        cpulist_parse(s->cpu_list, s->cpu_list_len, w->scratch, w->scratch_size) >= 0) {
+        const unsigned char *bits = (const unsigned char *)w->scratch;
+        nbytes = w->scratch_size;
+        while (nbytes > 0 && bits[nbytes - 1] == 0)
+            nbytes--;
+        cpus_changed = nbytes != t->cpus_len || memcmp(bits, t->cpus, nbytes) != 0;
+    }
+    if (!cpus_changed && s->exec_time == t->exec_time && s->wait_time == t->wait_time &&
+        s->timeslices == t->timeslices)
+        return 0;
+
+    if (ts_writer_reserve(w, 64 + nbytes) == -1)
+        return -1;
+    unsigned char *p = w->map + w->len;
+    *p++ = cpus_changed ? TS_CPUS : TS_SAMPLE;
+    p = ts_put_varint(p, idx);
+    p = ts_put_varint(p, ts_zigzag((int64_t)(s->exec_time - t->exec_time)));
+    p = ts_put_varint(p, ts_zigzag((int64_t)(s->wait_time - t->wait_time)));
+    p = ts_put_varint(p, ts_zigzag((int64_t)(s->timeslices - t->timeslices)));
+    if (cpus_changed) {
+        p = ts_put_varint(p, nbytes);
+        memcpy(p, w->scratch, nbytes);
+        p += nbytes;
+        if (nbytes > t->cpus_len) {
+            unsigned char *c = realloc(t->cpus, nbytes);
+            if (!c)
+                return -1;
+            t->cpus = c;
+        }
+        memcpy(t->cpus, w->scratch, nbytes);
+        t->cpus_len = nbytes;
+    }
+    w->len = p - w->map;
+    t->exec_time = s->exec_time;
+    t->wait_time = s->wait_time;
+    t->timeslices = s->timeslices;
+    return 0;
+}
+
+static inline int ts_writer_exit(struct ts_writer *w, size_t idx)
+{
+    if (ts_writer_reserve(w, 16) == -1)
+        return -1;
+    unsigned char *p = w->map + w->len;
+    *p++ = TS_EXIT;
+    p = ts_put_varint(p, idx);
+    w->len = p - w->map;
+    return 0;
+}
+
+/* Commit everything, cut the file to its real size and release it all. */
+static inline int ts_writer_close(struct ts_writer *w)
+{
+    int ret = 0;
+    ((struct ts_header *)w->map)->data_len = w->len - sizeof(struct ts_header);
+    munmap(w->map, w->cap);
+    if (ftruncate(w->fd, w->len) == -1)
+        ret = -1;
+    if (close(w->fd) == -1)
+        ret = -1;
+    for (size_t i = 0; i < w->ntasks; i++)
+        free(w->tasks[i].cpus);
+    free(w->tasks);
+    CPU_FREE(w->scratch);
+    w->fd = -1;
+    return ret;
+}
+
+#endif /* SCHEDSTAT_TS_H */
@@ -0,0 +1,202 @@
+/* schedstat_ts2csv.c
+
+   Convert a binary schedstat time series (schedstat_ts.h, as written by
+   schedstat_monitor -w) to CSV:
+
+       timestamp_ns,pid,tid,exec_time,wait_time,timeslices,cpu_list,exited
+
+   By default the output is dense: every live task gets a row at every
+   tick, with unchanged values carried forward. With -s only the samples
+   actually stored in the file (i.e. changes) are printed. An exiting task
+   gets a final row with exited set to 1.
+
+   Compile with:
+       gcc -O2 -Wall -o schedstat_ts2csv schedstat_ts2csv.c
+
+   Usage:
+       ./schedstat_ts2csv [-s] file.ssts > samples.csv
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include "schedstat_ts.h"
+
+struct task {
+    pid_t pid, tid;
+    int alive;
+    unsigned long long exec_time, wait_time, timeslices;
+    char *cpu_list;         /* canonical text of the current CPU set */
+};
+
+static struct task *tasks;
+static size_t ntasks, task_cap;
+static int sparse = 0;
+static cpu_set_t *scratch;
+static size_t scratch_size;
+static char *list_buf;
+static size_t list_buf_size;
+
+static void print_row(unsigned long long ts, const struct task *t, int exited) {
+    printf("%llu,%d,%d,%llu,%llu,%llu,\"%s\",%d\n", ts, t->pid, t->tid, t->exec_time,
+           t->wait_time, t->timeslices, t->cpu_list ? t->cpu_list : "", exited);
+}
+
+static void flush_tick(unsigned long long ts) {
+    for (size_t i = 0; i < ntasks; i++)
+        if (tasks[i].alive)
+            print_row(ts, &tasks[i], 0);
+}
+
+/* Replace the cached text of t's CPU set with the nbytes-long bitmap. */
+static int set_cpus(struct task *t, const unsigned char *bits, size_t nbytes) {
+    if (nbytes > scratch_size)
+        return -1;
+    CPU_ZERO_S(scratch_size, scratch);
+    memcpy(scratch, bits, nbytes);
+    size_t len = cpulist_format(scratch, scratch_size, list_buf, list_buf_size);
+    char *s = realloc(t->cpu_list, len + 1);
+    if (!s)
+        return -1;
+    memcpy(s, list_buf, len + 1);
+    t->cpu_list = s;
+    return 0;
+}
+
+static int add_task(pid_t pid, pid_t tid) {
+    if (ntasks == task_cap) {
+        task_cap = task_cap ? task_cap * 2 : 64;
+        struct task *n = realloc(tasks, task_cap * sizeof(*tasks));
+        if (!n)
+            return -1;
+        tasks = n;
+    }
+    memset(&tasks[ntasks], 0, sizeof(tasks[0]));
+    tasks[ntasks].pid = pid;
+    tasks[ntasks].tid = tid;
+    tasks[ntasks].alive = 1;
+    ntasks++;
+    return 0;
+}
+
+/* Decode the record stream in [p, end). Returns 0, or -1 if it is corrupt. */
+static int convert(const unsigned char *p, const unsigned char *end, unsigned long long ts) {
+    int in_tick = 0;
+    uint64_t a, b, c, d, n;
+
+    while (p < end) {
+        int type = *p++;
+        switch (type) {
+        case TS_TASK:
+            if (!(p = ts_get_varint(p, end, &a)) || !(p = ts_get_varint(p, end, &b)))
+                return -1;
+            if (add_task((pid_t)a, (pid_t)b) == -1)
+                return -1;
+            break;
+        case TS_TICK:
+            if (!(p = ts_get_varint(p, end, &a)))
+                return -1;
+            if (in_tick && !sparse)
+                flush_tick(ts);
+            ts += a;
+            in_tick = 1;
+            break;
+        case TS_SAMPLE:
+        case TS_CPUS:
+            if (!(p = ts_get_varint(p, end, &a)) || !(p = ts_get_varint(p, end, &b)) ||
+                !(p = ts_get_varint(p, end, &c)) || !(p = ts_get_varint(p, end, &d)) ||
+                a >= ntasks)
+                return -1;
+            tasks[a].exec_time += ts_unzigzag(b);
+            tasks[a].wait_time += ts_unzigzag(c);
+            tasks[a].timeslices += ts_unzigzag(d);
+            if (type == TS_CPUS) {
+                if (!(p = ts_get_varint(p, end, &n)) || n > (uint64_t)(end - p) ||
+                    set_cpus(&tasks[a], p, n) == -1)
+                    return -1;
+                p += n;
+            }
+            if (sparse)
+                print_row(ts, &tasks[a], 0);
+            break;
+        case TS_EXIT:
+            if (!(p = ts_get_varint(p, end, &a)) || a >= ntasks)
+                return -1;
+            tasks[a].alive = 0;
+            print_row(ts, &tasks[a], 1);
+            break;
+        default:
+            return -1;
+        }
+    }
+    if (in_tick && !sparse)
+        flush_tick(ts);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "s")) != -1) {
+        switch (opt) {
+        case 's': sparse = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-s] file\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-s] file\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) == -1) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if ((size_t)st.st_size < sizeof(struct ts_header)) {
+        fprintf(stderr, "%s: too short\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    const unsigned char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    const struct ts_header *h = (const struct ts_header *)map;
+    if (memcmp(h->magic, TS_MAGIC, 4) != 0 || h->version != TS_VERSION ||
+        h->data_len > st.st_size - sizeof(*h)) {
+        fprintf(stderr, "%s: not a version %d schedstat time series\n", argv[optind], TS_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    scratch = CPU_ALLOC(CPULIST_MAX_CPUS);
+    scratch_size = CPU_ALLOC_SIZE(CPULIST_MAX_CPUS);
+    list_buf_size = 6 * CPULIST_MAX_CPUS;
+    list_buf = malloc(list_buf_size);
+    if (!scratch || !list_buf) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    printf("timestamp_ns,pid,tid,exec_time,wait_time,timeslices,cpu_list,exited\n");
+    const unsigned char *data = map + sizeof(*h);
+    int ret = convert(data, data + h->data_len, h->start_ns);
+    if (ret == -1)
+        fprintf(stderr, "%s: corrupt record stream\n", argv[optind]);
+
+    for (size_t i = 0; i < ntasks; i++)
+        free(tasks[i].cpu_list);
+    free(tasks);
+    free(list_buf);
+    CPU_FREE(scratch);
+    munmap((void *)map, st.st_size);
+    close(fd);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,6 +7,10 @@
 #include <errno.h>
 #include <time.h>
 #include <assert.h>
+#include "../common/proctree.h"
+#include "schedstat_reader.h"
+#include "cpulist.h"
+#include "epoch_detect.h"
 
 // Utility: read and parse /proc/<pid>/schedstat.
 // Expected format: <exec_time_ns> <wait_time_ns> <timeslices> [<cpu_list>]
@@ -13,30 +18,51 @@ typedef struct {
     unsigned long long exec_time;
     unsigned long long wait_time;
     unsigned long timeslices;
-    char cpu_list[256]; // Adjust buffer size if needed
+    char cpu_list[256]; // For display only; may be truncated
+    cpu_set_t *cpus;    // The CPU list as a set (CPU_ALLOC'd, cpus_size bytes)
+    size_t cpus_size;
 } schedstat_info;
 
+// The schedstat file of the last PID read stays open and is re-read with
+// pread(), so repeated samples cost one syscall and no allocation.
+static char schedstat_buf[SCHEDSTAT_BUF_SIZE];
+static struct schedstat_reader schedstat_fd = { .fd = -1 };
+static pid_t schedstat_pid;
+
 int read_schedstat(pid_t pid, schedstat_info *info) {
-    char path[128];
-    snprintf(path, sizeof(path), "/proc/%d/schedstat", pid);
-    FILE *fp = fopen(path, "r");
-    if (!fp) {
-        perror("fopen");
-        return -1;
+    struct schedstat_sample s;
+    if (schedstat_fd.fd < 0 || schedstat_pid != pid) {
+        schedstat_close(&schedstat_fd);
+        if (schedstat_open(&schedstat_fd, pid, 0, schedstat_buf, sizeof(schedstat_buf)) == -1) {
+            perror("open schedstat");
+            return -1;
+        }
+        schedstat_pid = pid;
     }
-    // Read the first three numbers and the rest (the CPU list string)
-    // Format: "%llu %llu %lu %[^\n]"
-    int ret = fscanf(fp, "%llu %llu %lu %[^\n]",
-                     &info->exec_time, &info->wait_time, &info->timeslices,
-                     info->cpu_list);
-    fclose(fp);
-    if (ret < 3) {
+    if (schedstat_read(&schedstat_fd, &s) == -1) {
         fprintf(stderr, "schedstat format error for PID %d\n", pid);
         return -1;
     }
+    info->exec_time = s.exec_time;
+    info->wait_time = s.wait_time;
+    info->timeslices = s.timeslices;
+    // Keep the CPU list as a string (empty if the kernel does not report one)
+    size_t len = s.cpu_list_len < sizeof(info->cpu_list) - 1 ? s.cpu_list_len : sizeof(info->cpu_list) - 1;
+    memcpy(info->cpu_list, s.cpu_list ? s.cpu_list : "", len);
+    info->cpu_list[len] = '\0';
+    info->cpus = cpulist_parse_alloc(s.cpu_list ? s.cpu_list : "", s.cpu_list_len, &info->cpus_size);
+    if (!info->cpus) {
+        fprintf(stderr, "malformed CPU list for PID %d: %s\n", pid, info->cpu_list);
+        return -1;
+    }
     return 0;
 }
 
+void free_schedstat(schedstat_info *info) {
+    CPU_FREE(info->cpus);
+    info->cpus = NULL;
+}
+
 // Test 1: Validate that /proc/<pid>/schedstat contains at least three numbers and a CPU list.
 void test_format(void) {
     pid_t pid = getpid();
@@ -44,6 +70,7 @@ void test_format(void) {
     assert(read_schedstat(pid, &info) == 0);
     printf("Test Format: exec_time=%llu, wait_time=%llu, timeslices=%lu, cpu_list=%s\n",
            info.exec_time, info.wait_time, info.timeslices, info.cpu_list);
+    free_schedstat(&info);
 }
 
 // Test 2: Set affinity to a single CPU and verify that the CPU list shows only that CPU in the expected format.
@@ -60,12 +87,13 @@ void test_single_cpu_affinity(void) {
     sleep(2); // allow some scheduler ticks
     schedstat_info info;
     assert(read_schedstat(pid, &info) == 0);
-    // We expect the CPU list to be exactly "[0]"
-    if (strcmp(info.cpu_list, "[0]") != 0) {
+    // We expect the CPU set to be exactly {0}
+    if (!cpulist_equal(info.cpus, info.cpus_size, &mask, sizeof(mask))) {
         fprintf(stderr, "Test Single CPU Affinity failed: cpu_list = %s (expected \"[0]\")\n", info.cpu_list);
         exit(EXIT_FAILURE);
     }
     printf("Test Single CPU Affinity passed: cpu_list = %s\n", info.cpu_list);
+    free_schedstat(&info);
     // Reset affinity to all available CPUs
     CPU_ZERO(&mask);
     for (int i = 0; i < sysconf(_SC_NPROCESSORS_ONLN); i++) {
@@ -86,16 +114,26 @@ void busy_work(int seconds) {
 // Test 3: Allow process to run on multiple CPUs (if available) and check if the CPU list is in the expected range format.
 void test_multi_cpu_affinity(void) {
     pid_t pid = getpid();
-    cpu_set_t mask;
-    CPU_ZERO(&mask);
-    int num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t allowed, mask;
+    int cpus[2], num_cpus = 0;
+    // Use the first two CPUs we are allowed on, which need not be 0 and 1
+    // (affinity_sweep covers every subset).
+    if (sched_getaffinity(pid, sizeof(allowed), &allowed) != 0) {
+        perror("sched_getaffinity");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < CPU_SETSIZE && num_cpus < 2; c++) {
+        if (CPU_ISSET(c, &allowed))
+            cpus[num_cpus++] = c;
+    }
     if (num_cpus < 2) {
         printf("Test Multi CPU Affinity skipped (only one CPU available).\n");
         return;
     }
-    // Allow running on at least two CPUs: expecting the list to be "[0-1]"
-    CPU_SET(0, &mask);
-    CPU_SET(1, &mask);
+    // Allow running on those two CPUs: expecting the list to be "[a,b]" or "[a-b]"
+    CPU_ZERO(&mask);
+    CPU_SET(cpus[0], &mask);
+    CPU_SET(cpus[1], &mask);
     if (sched_setaffinity(pid, sizeof(mask), &mask) != 0) {
         perror("sched_setaffinity");
         exit(EXIT_FAILURE);
@@ -104,44 +142,132 @@ void test_multi_cpu_affinity(void) {
     busy_work(3);
     schedstat_info info;
     assert(read_schedstat(pid, &info) == 0);
-    // Check if cpu_list is exactly "[0-1]"
-    if (strcmp(info.cpu_list, "[0-1]") != 0) {
-        fprintf(stderr, "Test Multi CPU Affinity failed: cpu_list = %s (expected \"[0-1]\")\n", info.cpu_list);
+    // Check if the CPU set is exactly {a, b}
+    if (!cpulist_equal(info.cpus, info.cpus_size, &mask, sizeof(mask))) {
+        fprintf(stderr, "Test Multi CPU Affinity failed: cpu_list = %s (expected CPUs %d and %d)\n",
+                info.cpu_list, cpus[0], cpus[1]);
         exit(EXIT_FAILURE);
     }
     printf("Test Multi CPU Affinity passed: cpu_list = %s\n", info.cpu_list);
-    // Reset affinity to all available CPUs
-    CPU_ZERO(&mask);
-    for (int i = 0; i < num_cpus; i++) {
-        CPU_SET(i, &mask);
-    }
-    sched_setaffinity(pid, sizeof(mask), &mask);
+    free_schedstat(&info);
+    // Restore the original affinity
+    sched_setaffinity(pid, sizeof(allowed), &allowed);
 }
 
 // Test 4: Epoch boundary test.
-// We assume that after 10 seconds, the epoch resets: used CPU list should be cleared or updated.
-// For this test, we perform busy work, then sleep long enough for an epoch rollover,
-// then do more work and verify that the CPU list has changed.
+// Busy work while sampling our own schedstat every millisecond, hopping to the
+// next allowed CPU every 10 ms so that the CPU list grows within an epoch, until
+// the list loses a CPU: that sample is the first one of a new epoch (see
+// epoch_detect.h). Instead of sleeping past the rollover and comparing strings,
+// this measures exactly when it happened, and gives up after two epochs.
+// On a single allowed CPU the list never changes, so no reset can be seen.
+#define EPOCH_SEC 10
+
 void test_epoch_reset(void) {
-    pid_t pid = getpid();
-    schedstat_info before, after;
-    // Do some busy work so that there is nonzero data in the CPU list.
-    busy_work(3);
-    assert(read_schedstat(pid, &before) == 0);
-    printf("Before epoch reset: cpu_list = %s\n", before.cpu_list);
-    // Sleep for longer than an epoch (e.g., 12 seconds) to ensure a rollover.
-    sleep(12);
-    // Do some busy work again to get new scheduling info.
-    busy_work(3);
-    assert(read_schedstat(pid, &after) == 0);
-    printf("After epoch reset: cpu_list = %s\n", after.cpu_list);
-    // The used CPU list should have been reset at the start of the new epoch,
-    // so the new CPU list may be different from the previous epoch.
-    if (strcmp(before.cpu_list, after.cpu_list) == 0) {
-        fprintf(stderr, "Test Epoch Reset failed: cpu_list did not change across epochs.\n");
+    static char buf[SCHEDSTAT_BUF_SIZE];
+    struct schedstat_reader r;
+    struct schedstat_sample s;
+    struct epoch_detector d;
+    struct epoch_reset reset;
+    cpu_set_t allowed;
+    struct timespec ts;
+    int found = 0, cpu = -1;
+    volatile unsigned long dummy = 0;
+
+    assert(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+    if (CPU_COUNT(&allowed) < 2) {
+        printf("Test Epoch Reset skipped (only one CPU available).\n");
+        return;
+    }
+    assert(epoch_detector_init(&d) == 0);
+    assert(schedstat_open(&r, getpid(), 0, buf, sizeof(buf)) == 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t start = ts.tv_sec * 1000000000ULL + ts.tv_nsec, now = start, last_hop = 0;
+    while (!found && now - start < 2ULL * EPOCH_SEC * 1000000000ULL) {
+        if (now - last_hop >= 10000000) {
+            cpu = epoch_hop(&allowed, sizeof(allowed), cpu);
+            last_hop = now;
+        }
+        // Busy work until the next millisecond, then take a sample.
+        uint64_t until = now + 1000000;
+        while (now < until) {
+            dummy++;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            now = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+        assert(schedstat_read(&r, &s) == 0);
+        found = epoch_detector_feed(&d, &s, now, &reset);
+        if (found == -1) {
+            fprintf(stderr, "Test Epoch Reset failed: %s\n",
+                    errno == ENOTSUP ? "no CPU list in schedstat" : "malformed CPU list");
+            exit(EXIT_FAILURE);
+        }
+    }
+    sched_setaffinity(0, sizeof(allowed), &allowed);
+    schedstat_close(&r);
+    epoch_detector_destroy(&d);
+
+    if (!found) {
+        fprintf(stderr, "Test Epoch Reset failed: cpu_list did not reset within %d s.\n",
+                2 * EPOCH_SEC);
+        exit(EXIT_FAILURE);
+    }
+    printf("Test Epoch Reset passed: reset after %.3f s (exec_time %.6f s, +/- %.3f ms)\n",
+           (reset.wall_ns - start) / 1e9, reset.exec_time / 1e9, reset.exec_window / 1e6);
+}
+
+// Tree-node setup for test 5: keep the child busy, so that it has been
+// scheduled on its (inherited) CPU before it parks.
+static int burn(struct proctree *tree, int idx, void *arg) {
+    (void)tree; (void)idx; (void)arg;
+    busy_work(1);
+    return 0;
+}
+
+// Test 5: Read the schedstat of another process: a child forked while we are
+// pinned to our first allowed CPU never runs anywhere else, so its CPU list
+// must be exactly that CPU.
+void test_child_schedstat(void) {
+    cpu_set_t allowed, mask;
+    int target = -1;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        perror("sched_getaffinity");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < CPU_SETSIZE && target < 0; c++) {
+        if (CPU_ISSET(c, &allowed))
+            target = c;
+    }
+    // Pin ourselves before the fork: the child inherits the affinity, so
+    // it is not even placed on another CPU before it could pin itself.
+    CPU_ZERO(&mask);
+    CPU_SET(target, &mask);
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+        perror("sched_setaffinity");
+        exit(EXIT_FAILURE);
+    }
+    struct proctree tree;
+    if (proctree_create(&tree, "test(pinned)") == -1 ||
+        proctree_spawn(&tree, burn, NULL, NULL) == -1) {
+        perror("proctree");
+        exit(EXIT_FAILURE);
+    }
+    sched_setaffinity(0, sizeof(allowed), &allowed);
+    schedstat_info info;
+    int ret = read_schedstat(proctree_pid(&tree, "pinned"), &info);
+    proctree_release(&tree);
+    proctree_finish(&tree);
+    proctree_destroy(&tree);
+    assert(ret == 0);
+
+    if (!cpulist_equal(info.cpus, info.cpus_size, &mask, sizeof(mask))) {
+        fprintf(stderr, "Test Child Schedstat failed: cpu_list = %s (expected \"[%d]\")\n",
+                info.cpu_list, target);
         exit(EXIT_FAILURE);
     }
-    printf("Test Epoch Reset passed.\n");
+    printf("Test Child Schedstat passed: cpu_list = %s\n", info.cpu_list);
+    free_schedstat(&info);
 }
 
 int main(void) {
@@ -150,6 +276,7 @@ int main(void) {
     test_single_cpu_affinity();
     test_multi_cpu_affinity();
     test_epoch_reset();
+    test_child_schedstat();
     printf("All tests passed.\n");
     return 0;
 }
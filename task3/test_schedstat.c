@@ -42,22 +42,31 @@
 #include <time.h>
 #include <errno.h>
 #include <stdint.h>
+#include "schedstat_reader.h"
+#include "cpulist.h"
 
 /* A simple struct to hold the values parsed from /proc/self/schedstat. */
 typedef struct {
     unsigned long long cpu_time_ns;      // total time on CPU
     unsigned long long runqueue_ns;      // total time waiting in runqueue
     unsigned long long timeslices;       // number of timeslices on current CPU
-    char               used_cpus[256];   // bracketed CPU list (epoch mask)
+    char               used_cpus[256];   // bracketed CPU list (epoch mask), for display
+    cpu_set_t         *used_set;         // the same list as a set (CPU_ALLOC'd)
+    size_t             used_setsize;
 } schedstat_t;
 
+/* /proc/self/schedstat is opened once and re-read with pread(); the line is
+ * parsed in place by schedstat_parse() (see schedstat_reader.h). */
+static char schedstat_buf[SCHEDSTAT_BUF_SIZE];
+static struct schedstat_reader self_schedstat = { .fd = -1 };
+
 /* Parse /proc/self/schedstat to get the four fields.
  * Return 0 on success, -1 on failure. */
 int parse_schedstat(schedstat_t *stat)
 {
-    FILE *fp = fopen("/proc/self/schedstat", "r");
-    if (!fp) {
-        perror("fopen(/proc/self/schedstat)");
+    if (self_schedstat.fd < 0 &&
+        schedstat_open(&self_schedstat, getpid(), 0, schedstat_buf, sizeof(schedstat_buf)) == -1) {
+        perror("open(/proc/self/schedstat)");
         return -1;
     }
 
@@ -67,45 +76,39 @@ int parse_schedstat(schedstat_t *stat)
      * But with your modifications, there's now a fourth field in square brackets:
      *   <cpu_time_ns> <runqueue_ns> <timeslices> [0,1]
      * or possibly [0] or [] if no CPUs were used in the current epoch.
-     *
-     * We need to read the entire line, then parse accordingly.
      */
-    char buffer[512];
-    if (!fgets(buffer, sizeof(buffer), fp)) {
-        fclose(fp);
+    struct schedstat_sample s;
+    if (schedstat_read(&self_schedstat, &s) == -1 || !s.cpu_list) {
+        fprintf(stderr, "Unexpected schedstat format: %.*s\n", 128, schedstat_buf);
         return -1;
     }
-    fclose(fp);
-
-    /* The expected format:
-       <cpu_time_ns> <runqueue_ns> <timeslices> [comma-separated-CPU-list]
-       We can parse with sscanf if we carefully handle the bracketed part. */
-    unsigned long long cpu_time, rq_time, slices;
-    char bracket_buf[256];
-
-    /* 
-     * One approach: First scan for the three numeric fields plus the bracketed
-     * substring. The bracketed substring might contain commas and digits, so
-     * use a format specifier that reads until the trailing newline.
-     */
-    int fields = sscanf(buffer, "%llu %llu %llu %255[^\n]",
-                        &cpu_time, &rq_time, &slices, bracket_buf);
-    if (fields < 4) {
-        fprintf(stderr, "Unexpected schedstat format: %s\n", buffer);
+
+    /* s.cpu_list points at something like "[0,1]" or "[]" inside the read
+       buffer. We'll store it as-is into stat->used_cpus for printing, and
+       parsed into stat->used_set for membership checks. */
+    stat->cpu_time_ns = s.exec_time;
+    stat->runqueue_ns = s.wait_time;
+    stat->timeslices  = s.timeslices;
+    size_t len = s.cpu_list_len < sizeof(stat->used_cpus) - 1 ? s.cpu_list_len
+                                                            : sizeof(stat->used_cpus) - 1;
+    memcpy(stat->used_cpus, s.cpu_list, len);
+    stat->used_cpus[len] = '\0';
+
+    stat->used_set = cpulist_parse_alloc(s.cpu_list, s.cpu_list_len, &stat->used_setsize);
+    if (!stat->used_set) {
+        fprintf(stderr, "Malformed CPU list: %s\n", stat->used_cpus);
         return -1;
     }
 
-    /* bracket_buf should contain something like "[0,1]" or "[]".
-       We'll store it as-is into stat->used_cpus. */
-    stat->cpu_time_ns = cpu_time;
-    stat->runqueue_ns = rq_time;
-    stat->timeslices  = slices;
-    strncpy(stat->used_cpus, bracket_buf, sizeof(stat->used_cpus) - 1);
-    stat->used_cpus[sizeof(stat->used_cpus) - 1] = '\0';
-
     return 0;
 }
 
+/* Is `cpu` in the epoch CPU set of `stat`? */
+static int used_cpu(const schedstat_t *stat, int cpu)
+{
+    return CPU_ISSET_S(cpu, stat->used_setsize, stat->used_set) != 0;
+}
+
 /* Utility: do some CPU-bound work for `seconds` seconds. */
 void burn_cpu_for_seconds(int seconds)
 {
@@ -185,6 +188,10 @@ int main(void)
     if (after.cpu_time_ns <= before.cpu_time_ns) {
         fprintf(stderr, "WARNING: CPU time did not increase as expected!\n");
     }
+    int cur_cpu = sched_getcpu();
+    if (cur_cpu >= 0 && !used_cpu(&after, cur_cpu)) {
+        fprintf(stderr, "WARNING: current CPU %d is missing from used_cpus!\n", cur_cpu);
+    }
 
     /* 3. Create another thread pinned to a different CPU (if possible). */
     long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
@@ -219,7 +226,10 @@ int main(void)
         printf("  RQ time (ns)   = %llu\n", after_multi.runqueue_ns);
         printf("  Timeslices     = %llu\n", after_multi.timeslices);
         printf("  used_cpus      = %s\n\n", after_multi.used_cpus);
-        printf("Expected CPU mask to include [0,1] or similar.\n");
+        printf("Expected CPU mask to include [0,1] or similar: CPU 0 %s, CPU 1 %s.\n",
+               used_cpu(&after_multi, 0) ? "present" : "MISSING",
+               used_cpu(&after_multi, 1) ? "present" : "MISSING");
+        CPU_FREE(after_multi.used_set);
     }
 
     /* 4. Wait >10 seconds to force an epoch change, then re-check. */
@@ -235,8 +245,16 @@ int main(void)
     printf("  CPU time (ns)  = %llu\n", after_sleep.cpu_time_ns);
     printf("  RQ time (ns)   = %llu\n", after_sleep.runqueue_ns);
     printf("  Timeslices     = %llu\n", after_sleep.timeslices);
-    printf("  used_cpus      = %s\n", after_sleep.used_cpus);
+    printf("  used_cpus      = %s (%d CPU(s))\n", after_sleep.used_cpus,
+           CPU_COUNT_S(after_sleep.used_setsize, after_sleep.used_set));
     printf("Check if used_cpus is empty or significantly changed, as the epoch should reset it.\n");
+    printf("  same set as after the first burn: %s\n",
+           cpulist_equal(after.used_set, after.used_setsize,
+                         after_sleep.used_set, after_sleep.used_setsize) ? "yes" : "no");
+
+    CPU_FREE(before.used_set);
+    CPU_FREE(after.used_set);
+    CPU_FREE(after_sleep.used_set);
 
     printf("\nTest complete.\n");
     return 0;
@@ -17,19 +17,10 @@ sleep 2
 
 # Monitor the /proc/<PID>/schedstat output over time.
 # An epoch is defined as 10 seconds of runtime.
-# We'll run this loop for 20 seconds to see how the fourth field changes.
-for i in {1..20}; do
-    echo "Iteration $i:"
-    # Read the schedstat file.
-    # The expected format is: "exec_time wait_time timeslices [cpulist]"
-    SCHEDSTAT=$(cat /proc/$PID/schedstat 2>/dev/null)
-    if [ -z "$SCHEDSTAT" ]; then
-        echo "Process $PID has ended."
-        break
-    fi
-    echo "schedstat: $SCHEDSTAT"
-    sleep 1
-done
+# Sample once a second for 20 seconds to see how the fourth field changes.
+# Each output line is: "<timestamp_ns> <tid> exec_time wait_time timeslices [cpulist]"
+# (schedstat_monitor stops early and prints an EXIT line if the process ends).
+./schedstat_monitor -i 1000000 -d 20 $PID
 
 # Clean up: kill the cpu_burn process.
 kill $PID